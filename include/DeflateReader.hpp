@@ -0,0 +1,44 @@
+#pragma once
+
+#include "UploadSource.hpp"
+#include <zlib.h>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+namespace WebUtils {
+    /// @brief pull based zlib compressor, compresses its source straight into the buffer it's asked to fill
+    /// this way the compressed body never exists in memory as a whole
+    struct DeflateReader : public IUploadSource {
+        public:
+            /// @param source the data to compress, has to outlive the reader
+            /// @param gzip whether to write a gzip wrapper, otherwise writes a zlib wrapper (http "deflate")
+            /// @param level zlib compression level
+            DeflateReader(IUploadSource& source, bool gzip, int level);
+            ~DeflateReader();
+
+            DeflateReader(DeflateReader const&) = delete;
+            DeflateReader& operator=(DeflateReader const&) = delete;
+
+            /// @brief whether zlib initialized properly
+            bool valid() const noexcept { return _initialized; }
+
+            /// @brief compresses the next part of the data into buffer
+            /// @return amount of bytes written, 0 means the stream is done, nullopt means zlib or the source errored
+            virtual std::optional<std::size_t> Read(std::span<uint8_t> buffer) override;
+
+            /// @brief the source content type is kept, the compression is only a content encoding
+            virtual std::optional<std::string> ContentType() const override { return _source.ContentType(); }
+
+            virtual bool Rewind() override;
+        private:
+            IUploadSource& _source;
+            z_stream _stream{};
+            bool _initialized = false;
+            bool _inputDone = false;
+            bool _finished = false;
+            /// @brief uncompressed data read from the source, not yet consumed by zlib
+            std::array<uint8_t, 16 * 1024> _input;
+    };
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "Response.hpp"
+#include "Transport.hpp"
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace WebUtils {
+    /// @brief response kept as the raw transfer result, for when it only gets parsed later or not at all
+    struct RawResponse : public IResponse {
+        TransferResult result;
+
+        virtual int get_HttpCode() const noexcept override { return result.httpCode; }
+        virtual void set_HttpCode(int httpCode) noexcept override { result.httpCode = httpCode; }
+
+        virtual int get_CurlStatus() const noexcept override { return result.curlStatus; }
+        virtual void set_CurlStatus(int curlStatus) noexcept override { result.curlStatus = curlStatus; }
+
+        virtual bool AcceptData(std::span<uint8_t const> data) override { result.data.assign(data.begin(), data.end()); return true; }
+        virtual bool AcceptHeaders(std::string_view headers) override { result.headers.assign(headers); return true; }
+        virtual bool DataParsedSuccessful() const noexcept override { return true; }
+    };
+}
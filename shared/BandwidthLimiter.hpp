@@ -0,0 +1,66 @@
+#pragma once
+
+#include "./_config.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+
+namespace WebUtils {
+    /// @brief priority class of a request's traffic
+    enum class TrafficClass {
+        /// @brief latency sensitive traffic like score submission or multiplayer, always gets its share of the bandwidth
+        Foreground,
+        /// @brief bulk traffic like prefetching or batch downloads, throttled further while foreground traffic is going
+        Background,
+    };
+
+    /// @brief token bucket limiting the bandwidth of every transfer sharing it.
+    /// while any foreground request is in flight, background traffic also has to get through a smaller bucket of backgroundShare of the rate,
+    /// so foreground traffic keeps at least the rest. without foreground requests, background traffic can use the full rate
+    struct WEBUTILS_EXPORT BandwidthLimiter {
+        public:
+            /// @param bytesPerSecond total rate of all transfers together, 0 means unlimited
+            /// @param backgroundShare share of the rate background traffic may use while foreground requests are in flight, 0 - 1
+            /// @param burst how much unused bandwidth may be saved up, as time at the full rate
+            explicit BandwidthLimiter(std::size_t bytesPerSecond = 0, double backgroundShare = 0.25, std::chrono::milliseconds burst = std::chrono::milliseconds(100));
+
+            /// @brief the limiter used by downloaders that don't have their own, unlimited until a rate is set
+            static BandwidthLimiter& Default();
+
+            /// @brief changes the total rate, 0 means unlimited
+            void SetRate(std::size_t bytesPerSecond);
+            /// @brief the total rate, 0 means unlimited
+            std::size_t GetRate() const noexcept { return _rate.load(std::memory_order_relaxed); }
+
+            /// @brief blocks the calling transfer until it may send or receive this many bytes
+            void Acquire(std::size_t bytes, TrafficClass trafficClass);
+
+            /// @brief marks a request as in flight for as long as it lives, in flight foreground requests make background traffic back off
+            struct WEBUTILS_EXPORT ActiveRequest {
+                public:
+                    ActiveRequest(BandwidthLimiter& limiter, TrafficClass trafficClass) noexcept;
+                    ~ActiveRequest();
+
+                    ActiveRequest(ActiveRequest const&) = delete;
+                    ActiveRequest& operator=(ActiveRequest const&) = delete;
+                private:
+                    BandwidthLimiter& _limiter;
+                    TrafficClass _trafficClass;
+            };
+        private:
+            /// @brief adds the tokens gained since the last refill, call with the mutex held
+            void Refill(std::chrono::steady_clock::time_point now);
+
+            std::atomic<std::size_t> _rate;
+            double _backgroundShare;
+            std::chrono::milliseconds _burst;
+            std::atomic<std::size_t> _activeForeground = 0;
+
+            std::mutex _mutex;
+            /// @brief bytes that may still be transferred, negative while transfers are paying off what they took
+            double _tokens = 0;
+            double _backgroundTokens = 0;
+            std::chrono::steady_clock::time_point _lastRefill = std::chrono::steady_clock::now();
+    };
+}
@@ -2,12 +2,33 @@
 
 #include "./_config.h"
 #include "./Response.hpp"
+#include "./UploadSource.hpp"
+#include "./RetryPolicy.hpp"
+#include "./ThreadPool.hpp"
+#include "./Transport.hpp"
+#include "./Tracing.hpp"
+#include "./BandwidthLimiter.hpp"
 #include <future>
 #include <thread>
 #include <iterator>
 #include <type_traits>
 
+// curl header list, kept opaque so curl isn't needed to include this header
+struct curl_slist;
+
 namespace WebUtils {
+    struct StartupPrefetcher;
+
+    /// @brief compression to apply to a request body before sending it
+    enum class BodyCompression {
+        /// @brief send the body as is
+        None,
+        /// @brief gzip the body, sent with "Content-Encoding: gzip"
+        Gzip,
+        /// @brief zlib wrapped deflate, sent with "Content-Encoding: deflate"
+        Deflate,
+    };
+
     struct WEBUTILS_EXPORT URLOptions {
         using QueryMap = std::unordered_map<std::string, std::string>;
         using HeaderMap = std::unordered_map<std::string, std::string>;
@@ -33,6 +54,10 @@ namespace WebUtils {
         bool useSSL;
         /// @brief whether to skip escaping the url, in case you just want your url to be passed raw
         bool noEscape;
+        /// @brief compression applied to posted data, the server has to support the set Content-Encoding
+        BodyCompression bodyCompression = BodyCompression::None;
+        /// @brief priority class of the request's traffic, if not set uses the downloader utility set class
+        std::optional<TrafficClass> trafficClass;
 
         /// @brief formats the url from the set url & queries, also escape
         std::string fullURl() const;
@@ -40,14 +65,83 @@ namespace WebUtils {
         /// @brief gets whatever is in front of "://" in the url, empty string view otherwise
         std::string_view protocol() const;
 
+        /// @brief gets the lowercase protocol & host (with port) of the url, like "https://example.com:8080", empty string if there is no protocol
+        std::string origin() const;
+
         /// @brief checks whether this is a file URL, useful to know
         constexpr bool isFileURL() const noexcept { return protocol() == "file"; }
     };
 
+    /// @brief immutable request built once from url options, with everything curl needs already resolved.
+    /// reusing one for retries or repeated polling skips escaping the url & building the headers every time
+    struct WEBUTILS_EXPORT PreparedRequest {
+        public:
+            /// @param options the url options to prepare
+            /// @param defaultUserAgent user agent to use if options doesn't have one set
+            /// @param defaultTimeOut timeout to use if options doesn't have one set
+            PreparedRequest(URLOptions options, std::string_view defaultUserAgent, int defaultTimeOut);
+            ~PreparedRequest();
+
+            PreparedRequest(PreparedRequest const&) = delete;
+            PreparedRequest& operator=(PreparedRequest const&) = delete;
+            PreparedRequest(PreparedRequest&& other) noexcept;
+            PreparedRequest& operator=(PreparedRequest&& other) noexcept;
+
+            /// @brief the options this request was prepared from
+            URLOptions const& options() const noexcept { return _options; }
+            /// @brief the formatted & escaped url
+            std::string const& escapedURL() const noexcept { return _escapedURL; }
+            /// @brief the curl header list built from the option headers, owned by this request
+            curl_slist* headerList() const noexcept { return _headerList; }
+            /// @brief the resolved user agent
+            std::string const& userAgent() const noexcept { return _userAgent; }
+            /// @brief the resolved timeout
+            int timeOut() const noexcept { return _timeOut; }
+        private:
+            URLOptions _options;
+            std::string _escapedURL;
+            curl_slist* _headerList = nullptr;
+            std::string _userAgent;
+            int _timeOut;
+    };
+
     struct WEBUTILS_EXPORT DownloaderUtility {
         public:
             std::string userAgent;
             int timeOut;
+            /// @brief retry policy for GET requests, doesn't retry by default
+            RetryPolicy retryPolicy{};
+            /// @brief if set, GET requests that take unusually long get a duplicate sent & the first response is used
+            std::optional<HedgePolicy> hedgePolicy{};
+            /// @brief latencies of earlier requests per host, used by the hedge policy. copies of the downloader share it
+            std::shared_ptr<LatencyTracker> latencyTracker = std::make_shared<LatencyTracker>();
+            /// @brief pool the async requests run on, if null the shared default pool is used
+            std::shared_ptr<ThreadPool> threadPool{};
+
+            /// @brief the pool async requests of this downloader run on
+            ThreadPool& Pool() const { return threadPool ? *threadPool : ThreadPool::Default(); }
+            /// @brief what performs the requests, if null requests go through libcurl
+            std::shared_ptr<ITransport> transport{};
+
+            /// @brief the transport requests of this downloader go through
+            ITransport& Transport() const { return transport ? *transport : CurlTransport::Default(); }
+            /// @brief limits the bandwidth of the transfers of this downloader, if null the shared default limiter is used
+            std::shared_ptr<BandwidthLimiter> bandwidthLimiter{};
+            /// @brief traffic class for requests that don't set one
+            TrafficClass trafficClass = TrafficClass::Foreground;
+
+            /// @brief the limiter transfers of this downloader go through
+            BandwidthLimiter& Limiter() const { return bandwidthLimiter ? *bandwidthLimiter : BandwidthLimiter::Default(); }
+            /// @brief records startup requests & hands out their prefetched responses, if null the shared default prefetcher is used
+            std::shared_ptr<StartupPrefetcher> prefetcher{};
+
+            /// @brief the prefetcher foreground GET requests of this downloader are checked against
+            StartupPrefetcher& Prefetcher() const;
+
+            /// @brief prepares a request with this downloader's user agent & timeout as defaults
+            /// @param urlOptions the url options to prepare
+            /// @return prepared request, reusable for as many requests as you want
+            PreparedRequest Prepare(URLOptions urlOptions) const;
 
 #pragma region GET
             /// @brief generic get for IResponse classes
@@ -56,7 +150,9 @@ namespace WebUtils {
             template<response_impl T>
             requires(std::is_default_constructible_v<T>)
             std::future<T> GetAsync(URLOptions urlOptions, std::function<void(float)> progressReport = nullptr) const {
-                return std::async(std::launch::any, &DownloaderUtility::Get<T>, this, std::forward<URLOptions>(urlOptions), std::forward<std::function<void(float)>>(progressReport));
+                return Pool().Submit([this, urlOptions = std::move(urlOptions), progressReport = std::move(progressReport)](){
+                    return Get<T>(urlOptions, progressReport);
+                });
             }
 
             /// @brief generic async get for IResponse classes
@@ -67,21 +163,23 @@ namespace WebUtils {
             void GetAsync(URLOptions urlOptions, std::function<void(T)> onFinished, std::function<void(float)> progressReport = nullptr) const {
                 if (!onFinished) return;
 
-                std::thread([this](URLOptions urlOptions, std::function<void(T)> onFinished, std::function<void(float)> progressReport){
-                    onFinished(Get<T>(urlOptions, progressReport));
-                }, std::forward<URLOptions>(urlOptions), std::forward<std::function<void(T)>>(onFinished), std::forward<std::function<void(float)>>(progressReport)).detach();
+                Pool().Enqueue([this, urlOptions = std::move(urlOptions), onFinished = std::move(onFinished), progressReport = std::move(progressReport)](){
+                    auto response = Get<T>(urlOptions, progressReport);
+                    Tracing::ScopedSpan span("onFinished", "callback", Tracing::IdOf(&response));
+                    onFinished(std::move(response));
+                });
             }
 
             /// @param progressReport progress callback as a float from 0 - 1, allowed to be null
             template<response_impl T>
             requires(std::is_default_constructible_v<T>)
-            T Get(URLOptions urlOptions, std::function<void(float)> progressReport = nullptr) const {
+            T Get(URLOptions const& urlOptions, std::function<void(float)> progressReport = nullptr) const {
                 T response{};
-                GetInto(std::forward<URLOptions>(urlOptions), &response, progressReport);
+                GetInto(urlOptions, &response, progressReport);
                 return response;
             }
 
-            /// @brief gets data from a url synchronously
+            /// @brief gets data from a url synchronously, retried & hedged according to the retry & hedge policy
             /// @param urlOptions the url options to pass to curl
             /// @param targetResponse response to get into
             /// @param progressReport progress callback as a float from 0 - 1, allowed to be null
@@ -92,8 +190,28 @@ namespace WebUtils {
             /// @param progressReport progress callback as a float from 0 - 1, allowed to be null
             /// @return whether there was data & it was parsed successfully
             std::future<bool> GetAsyncInto(URLOptions urlOptions, IResponse* targetResponse, std::function<void(float)> progressReport = nullptr) const {
-                return std::async(std::launch::any, &DownloaderUtility::GetInto, this, std::forward<URLOptions>(urlOptions), targetResponse, std::forward<std::function<void(float)>>(progressReport));
+                return Pool().Submit([this, urlOptions = std::move(urlOptions), targetResponse, progressReport = std::move(progressReport)](){
+                    return GetInto(urlOptions, targetResponse, progressReport);
+                });
+            }
+            /// @brief generic get for IResponse classes using a prepared request
+            /// @param prepared the prepared request to use
+            /// @param progressReport progress callback as a float from 0 - 1, allowed to be null
+            template<response_impl T>
+            requires(std::is_default_constructible_v<T>)
+            T Get(PreparedRequest const& prepared, std::function<void(float)> progressReport = nullptr) const {
+                T response{};
+                GetInto(prepared, &response, progressReport);
+                return response;
             }
+
+            /// @brief gets data from a url synchronously using a prepared request, retried & hedged according to the retry & hedge policy
+            /// @param prepared the prepared request to use
+            /// @param targetResponse response to get into
+            /// @param progressReport progress callback as a float from 0 - 1, allowed to be null
+            /// @param liveTrafficClass if set, the traffic class used instead of the downloader's, read while the request is going so it can be raised midway
+            /// @return data parsed successfully
+            bool GetInto(PreparedRequest const& prepared, IResponse* targetResponse, std::function<void(float)> progressReport = nullptr, std::atomic<TrafficClass> const* liveTrafficClass = nullptr) const;
 #pragma endregion // GET
 
 #pragma region POST
@@ -105,7 +223,9 @@ namespace WebUtils {
             template<typename T = void>
             requires((response_impl<T> && std::is_default_constructible_v<T>) || std::is_same_v<T, void>)
             std::future<T> PostAsync(URLOptions urlOptions, std::span<uint8_t const> data, std::function<void(float)> progressReport = nullptr) const {
-                return std::async(std::launch::any, &DownloaderUtility::Post<T>, this, std::forward<URLOptions>(urlOptions), std::forward<std::span<uint8_t const>>(data), std::forward<std::function<void(float)>>(progressReport));
+                return Pool().Submit([this, urlOptions = std::move(urlOptions), data, progressReport = std::move(progressReport)](){
+                    return Post<T>(urlOptions, data, progressReport);
+                });
             }
 
             /// @brief generic async get for IResponse classes
@@ -118,9 +238,11 @@ namespace WebUtils {
             void PostAsync(URLOptions urlOptions, std::span<uint8_t const> data, std::function<void(T)> onFinished, std::function<void(float)> progressReport = nullptr) const {
                 if (!onFinished) return;
 
-                std::thread([this](URLOptions urlOptions, std::span<uint8_t const> data, std::function<void(T)> onFinished, std::function<void(float)> progressReport){
-                    onFinished(Post<T>(urlOptions, data, progressReport));
-                }, std::forward<URLOptions>(urlOptions), std::forward<std::span<uint8_t const>>(data), std::forward<std::function<void(T)>>(onFinished), std::forward<std::function<void(float)>>(progressReport)).detach();
+                Pool().Enqueue([this, urlOptions = std::move(urlOptions), data, onFinished = std::move(onFinished), progressReport = std::move(progressReport)](){
+                    auto response = Post<T>(urlOptions, data, progressReport);
+                    Tracing::ScopedSpan span("onFinished", "callback", Tracing::IdOf(&response));
+                    onFinished(std::move(response));
+                });
             }
 
             /// @brief generic post method
@@ -131,7 +253,7 @@ namespace WebUtils {
             /// @return request response
             template<response_impl T>
             requires(std::is_default_constructible_v<T>)
-            T Post(URLOptions urlOptions, std::span<uint8_t const> data, std::function<void(float)> progressReport = nullptr) const {
+            T Post(URLOptions const& urlOptions, std::span<uint8_t const> data, std::function<void(float)> progressReport = nullptr) const {
                 T response{};
                 PostInto(urlOptions, data, &response, progressReport);
                 return response;
@@ -152,8 +274,113 @@ namespace WebUtils {
             /// @param progressReport progress callback as a float from 0 - 1, allowed to be null
             /// @return data parsed successfully
             std::future<bool> PostAsyncInto(URLOptions urlOptions, std::span<uint8_t const> data, IResponse* targetResponse, std::function<void(float)> progressReport = nullptr) {
-                return std::async(std::launch::any, &DownloaderUtility::PostInto, this, std::forward<URLOptions>(urlOptions), std::forward<std::span<uint8_t const>>(data), std::forward<IResponse*>(targetResponse), std::forward<std::function<void(float)>>(progressReport));
+                return Pool().Submit([this, urlOptions = std::move(urlOptions), data, targetResponse, progressReport = std::move(progressReport)](){
+                    return PostInto(urlOptions, data, targetResponse, progressReport);
+                });
+            }
+
+            /// @brief generic async post method, streaming the data from a source
+            /// @param urlOptions the url options to pass to curl
+            /// @param source the data to send, owned by the request
+            /// @param progressReport progress callback as a float from 0 - 1, allowed to be null
+            /// @return future response
+            template<response_impl T>
+            requires(std::is_default_constructible_v<T>)
+            std::future<T> PostAsync(URLOptions urlOptions, std::unique_ptr<IUploadSource> source, std::function<void(float)> progressReport = nullptr) const {
+                if (!source) {
+                    T response{};
+                    response.CurlStatus = NO_SOURCE_STATUS;
+                    response.HttpCode = 0;
+                    std::promise<T> failed;
+                    failed.set_value(std::move(response));
+                    return failed.get_future();
+                }
+
+                return Pool().Submit([this, urlOptions = std::move(urlOptions), source = std::move(source), progressReport = std::move(progressReport)](){
+                    return Post<T>(urlOptions, *source, progressReport);
+                });
+            }
+
+            /// @brief generic async post for IResponse classes, streaming the data from a source
+            /// @param urlOptions the url options to pass to curl
+            /// @param source the data to send, owned by the request
+            /// @param onFinished method called with the result of the post request, if null the request doesn't happen
+            /// @param progressReport progress callback as a float from 0 - 1, allowed to be null
+            template<response_impl T>
+            requires(std::is_default_constructible_v<T>)
+            void PostAsync(URLOptions urlOptions, std::unique_ptr<IUploadSource> source, std::function<void(T)> onFinished, std::function<void(float)> progressReport = nullptr) const {
+                if (!onFinished || !source) return;
+
+                Pool().Enqueue([this, urlOptions = std::move(urlOptions), source = std::move(source), onFinished = std::move(onFinished), progressReport = std::move(progressReport)](){
+                    auto response = Post<T>(urlOptions, *source, progressReport);
+                    Tracing::ScopedSpan span("onFinished", "callback", Tracing::IdOf(&response));
+                    onFinished(std::move(response));
+                });
+            }
+
+            /// @brief generic post method, streaming the data from a source
+            /// @tparam T expected response type
+            /// @param urlOptions the url options to pass to curl
+            /// @param source the data to send, read while the request is going
+            /// @param progressReport progress callback as a float from 0 - 1, allowed to be null
+            /// @return request response
+            template<response_impl T>
+            requires(std::is_default_constructible_v<T>)
+            T Post(URLOptions const& urlOptions, IUploadSource& source, std::function<void(float)> progressReport = nullptr) const {
+                T response{};
+                PostInto(urlOptions, source, &response, progressReport);
+                return response;
+            }
+
+            /// @brief posts to a url synchronously, streaming the data from a source
+            /// if the source size is unknown the data is sent with chunked transfer encoding
+            /// @param urlOptions the url options to pass to curl
+            /// @param source the data to send, read while the request is going
+            /// @param targetResponse post responses may contain response data, this is where it gets parsed into
+            /// @param progressReport progress callback as a float from 0 - 1, allowed to be null
+            /// @return data parsed successfully
+            bool PostInto(URLOptions urlOptions, IUploadSource& source, IResponse* targetResponse, std::function<void(float)> progressReport = nullptr) const;
+
+            /// @brief posts to a url async, streaming the data from a source
+            /// @param urlOptions the url options to pass to curl
+            /// @param source the data to send, owned by the request
+            /// @param targetResponse post responses may contain response data, this is where it gets parsed into
+            /// @param progressReport progress callback as a float from 0 - 1, allowed to be null
+            /// @return data parsed successfully
+            std::future<bool> PostAsyncInto(URLOptions urlOptions, std::unique_ptr<IUploadSource> source, IResponse* targetResponse, std::function<void(float)> progressReport = nullptr) const {
+                if (!source) {
+                    if (targetResponse) {
+                        targetResponse->CurlStatus = NO_SOURCE_STATUS;
+                        targetResponse->HttpCode = 0;
+                    }
+                    std::promise<bool> failed;
+                    failed.set_value(false);
+                    return failed.get_future();
+                }
+
+                return Pool().Submit([this, urlOptions = std::move(urlOptions), source = std::move(source), targetResponse, progressReport = std::move(progressReport)](){
+                    return PostInto(urlOptions, *source, targetResponse, progressReport);
+                });
             }
+
+            /// @brief posts to a url synchronously using a prepared request
+            /// @param prepared the prepared request to use
+            /// @param source the data to send, read while the request is going
+            /// @param targetResponse post responses may contain response data, this is where it gets parsed into
+            /// @param progressReport progress callback as a float from 0 - 1, allowed to be null
+            /// @return data parsed successfully
+            bool PostInto(PreparedRequest const& prepared, IUploadSource& source, IResponse* targetResponse, std::function<void(float)> progressReport = nullptr) const;
+
+            /// @brief posts to a url synchronously using a prepared request
+            /// @param prepared the prepared request to use
+            /// @param data the data to send.
+            /// @param targetResponse post responses may contain response data, this is where it gets parsed into
+            /// @param progressReport progress callback as a float from 0 - 1, allowed to be null
+            /// @return data parsed successfully
+            bool PostInto(PreparedRequest const& prepared, std::span<uint8_t const> data, IResponse* targetResponse, std::function<void(float)> progressReport = nullptr) const;
 #pragma endregion // POST
+        private:
+            /// @brief curl status of posts without a source, same as curl's "read error" since there is nothing to read the body from
+            static constexpr int NO_SOURCE_STATUS = 26;
     };
 }
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "./_config.h"
+#include "./Transport.hpp"
+#include "./DownloaderUtility.hpp"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace WebUtils {
+    /// @brief a request as it arrives at a loopback handler
+    struct WEBUTILS_EXPORT LoopbackRequest {
+        /// @brief http method, "GET" or "POST"
+        std::string_view method;
+        /// @brief the escaped url including queries
+        std::string_view url;
+        /// @brief the request headers, including ones added for the body
+        URLOptions::HeaderMap headers;
+        /// @brief the body as it would have been sent, so still compressed if it was
+        std::vector<uint8_t> body;
+    };
+
+    /// @brief a scripted response of a loopback transport
+    struct WEBUTILS_EXPORT LoopbackResponse {
+        int httpCode = 200;
+        std::vector<uint8_t> data;
+        URLOptions::HeaderMap headers;
+
+        /// @brief response with a text body
+        static LoopbackResponse Text(std::string_view text, int httpCode = 200) {
+            return { .httpCode = httpCode, .data = std::vector<uint8_t>(text.begin(), text.end()) };
+        }
+    };
+
+    /// @brief simulated network conditions of a loopback transport
+    struct WEBUTILS_EXPORT LoopbackConditions {
+        /// @brief time before the response starts arriving
+        std::chrono::microseconds latency{0};
+        /// @brief random extra latency between 0 & this
+        std::chrono::microseconds jitter{0};
+        /// @brief bytes per second, for the request body & the response together. 0 means unlimited
+        std::size_t bandwidth = 0;
+        /// @brief chance of a request failing without a response, 0 - 1
+        double errorRate = 0;
+        /// @brief curl code of failed requests, by default "couldn't connect"
+        int errorCode = 7;
+        /// @brief chance of a request getting httpErrorCode instead of its scripted response, 0 - 1
+        double httpErrorRate = 0;
+        int httpErrorCode = 503;
+    };
+
+    /// @brief in process transport serving scripted responses under simulated network conditions, no sockets involved.
+    /// random latency & errors come from a seeded generator, so runs with the same seed & request order behave the same
+    struct WEBUTILS_EXPORT LoopbackTransport : public ITransport {
+        public:
+            using Handler = std::function<LoopbackResponse(LoopbackRequest const&)>;
+
+            /// @param conditions the network conditions to simulate
+            /// @param seed seed for the random latency & errors
+            explicit LoopbackTransport(LoopbackConditions conditions = {}, uint32_t seed = 0);
+
+            /// @brief serves every url starting with urlPrefix through a handler, the longest matching prefix wins.
+            /// handlers can get called from multiple threads at once
+            void Serve(std::string urlPrefix, Handler handler);
+
+            /// @brief serves every url starting with urlPrefix with a fixed response
+            void Serve(std::string urlPrefix, LoopbackResponse response);
+
+            /// @brief changes the simulated conditions for requests started after this
+            void SetConditions(LoopbackConditions conditions);
+
+            /// @brief how many requests arrived at handlers so far, hedged duplicates included
+            std::size_t RequestCount() const noexcept { return _requestCount; }
+
+            virtual TransferResult Perform(TransferRequest const& request) override;
+
+            /// @brief simulates both attempts up front, then waits for whichever would have finished first
+            virtual TransferResult PerformHedged(TransferRequest const& request, std::chrono::microseconds hedgeDelay) override;
+        private:
+            /// @brief outcome of a simulated request, without the waiting
+            struct Attempt {
+                TransferResult result;
+                /// @brief time until the response starts arriving
+                std::chrono::microseconds latency;
+                /// @brief time the body & response take to transfer
+                std::chrono::microseconds transfer;
+            };
+
+            Attempt Simulate(TransferRequest const& request, std::vector<uint8_t> const& body);
+            /// @brief waits out an attempt, reporting progress & going through the bandwidth limiter while the data "transfers". fails with a timeout if it takes too long
+            void Wait(TransferRequest const& request, Attempt& attempt, std::size_t bodySize, bool reportProgress) const;
+
+            mutable std::mutex _mutex;
+            std::vector<std::pair<std::string, Handler>> _routes;
+            LoopbackConditions _conditions;
+            std::mt19937 _random;
+            std::atomic<std::size_t> _requestCount = 0;
+    };
+}
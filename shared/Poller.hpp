@@ -0,0 +1,122 @@
+#pragma once
+
+#include "./_config.h"
+#include "./DownloaderUtility.hpp"
+#include "./Response.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace WebUtils {
+    /// @brief how often a url gets polled
+    struct WEBUTILS_EXPORT PollOptions {
+        /// @brief time between the end of one poll & the start of the next
+        std::chrono::milliseconds interval;
+        /// @brief random share of the interval added or taken off every time, 0 - 1. keeps polls that started together from staying together
+        double jitter = 0.1;
+        /// @brief whether the first poll goes out right away, otherwise it goes out at a random point within the first interval
+        bool immediate = false;
+    };
+
+    /// @brief polls urls periodically from a timer wheel, so thousands of polls share one timer thread & a thread pool.
+    /// polls are conditional requests using the ETag & Last-Modified of the last response,
+    /// & consumers only get called when the content changed
+    struct WEBUTILS_EXPORT Poller {
+        public:
+            using PollId = uint64_t;
+            /// @brief called with the raw response of a poll, only when the content changed
+            using ChangeHandler = std::function<void(TransferResult const& response)>;
+
+            /// @param tick resolution of the timer wheel
+            explicit Poller(std::chrono::milliseconds tick = WEBUTILS_POLL_TICK);
+            /// @brief stops every poll, waiting for the ones in flight. must not be destroyed from one of its own consumers
+            virtual ~Poller();
+
+            Poller(Poller const&) = delete;
+            Poller& operator=(Poller const&) = delete;
+
+            /// @brief downloader the polls go through, change it before starting polls. polls run on its thread pool,
+            /// by default one of the poller's own so a lot of polls can't hold up the async requests on the shared pool
+            DownloaderUtility downloader{.userAgent = WEBUTILS_USER_AGENT, .timeOut = WEBUTILS_TIMEOUT, .threadPool = std::make_shared<ThreadPool>(WEBUTILS_POLL_POOL_SIZE)};
+
+            /// @brief starts polling a url
+            /// @param urlOptions the url options to poll
+            /// @param options interval & jitter of the poll
+            /// @param onChanged called with the parsed response whenever the content changed, the first response included. NOT RAN ON MAIN OR BOUND IL2CPP THREAD
+            /// @return id to cancel the poll with, 0 if onChanged was null
+            template<response_impl T>
+            requires(std::is_default_constructible_v<T>)
+            PollId Poll(URLOptions urlOptions, PollOptions options, std::function<void(T)> onChanged) {
+                if (!onChanged) return 0;
+
+                return Poll(std::move(urlOptions), options, [onChanged = std::move(onChanged)](TransferResult const& raw) {
+                    T response{};
+                    response.CurlStatus = raw.curlStatus;
+                    response.HttpCode = raw.httpCode;
+                    response.AcceptData(raw.data);
+                    response.AcceptHeaders(raw.headers);
+                    onChanged(std::move(response));
+                });
+            }
+
+            /// @brief starts polling a url, handing the consumer the raw response
+            /// @param urlOptions the url options to poll
+            /// @param options interval & jitter of the poll
+            /// @param onChanged called with the response whenever the content changed, the first response included. NOT RAN ON MAIN OR BOUND IL2CPP THREAD
+            /// @return id to cancel the poll with, 0 if onChanged was null
+            PollId Poll(URLOptions urlOptions, PollOptions options, ChangeHandler onChanged);
+
+            /// @brief stops a poll. a consumer that's already running still finishes
+            /// @return whether there was a poll with this id
+            bool Cancel(PollId id);
+
+            /// @brief amount of active polls
+            std::size_t PollCount();
+        private:
+            struct PollState;
+
+            /// @brief a poll waiting in a slot of the wheel
+            struct WheelEntry {
+                PollId id;
+                /// @brief the tick the poll is due at, entries for later turns of the wheel share the slot
+                uint64_t dueTick;
+            };
+
+            std::chrono::milliseconds _tick;
+            std::chrono::steady_clock::time_point _start;
+            std::once_flag _started;
+            std::thread _timer;
+
+            /// @brief mutex guarding everything below
+            std::mutex _mutex;
+            /// @brief notified when stopping & when a poll finishes
+            std::condition_variable _changed;
+            std::vector<std::vector<WheelEntry>> _wheel;
+            /// @brief ticks the wheel did so far
+            uint64_t _currentTick = 0;
+            std::unordered_map<PollId, std::shared_ptr<PollState>> _polls;
+            PollId _nextId = 1;
+            /// @brief polls handed to the thread pool that didn't finish yet
+            std::size_t _inFlight = 0;
+            bool _stopping = false;
+
+            /// @brief starts the timer thread
+            void StartTimer();
+
+            /// @brief advances the wheel every tick, handing due polls to the thread pool
+            void TimerThread();
+
+            /// @brief puts a poll on the wheel to go out after delay, call with the mutex held
+            void Schedule(PollId id, std::chrono::milliseconds delay);
+
+            /// @brief performs a poll & puts it back on the wheel
+            void RunPoll(std::shared_ptr<PollState> poll);
+    };
+}
@@ -6,8 +6,11 @@
 #include <atomic>
 #include <shared_mutex>
 #include <chrono>
+#include <condition_variable>
+#include <memory>
 #include <queue>
 #include <type_traits>
+#include <unordered_map>
 
 namespace WebUtils {
     class WEBUTILS_EXPORT IRequest {
@@ -18,6 +21,16 @@ namespace WebUtils {
             virtual IResponse* get_TargetResponse() = 0;
             virtual IResponse const* get_TargetResponse() const = 0;
 
+            /// @brief prepared request to use instead of the url, if null the request gets prepared by the dispatcher
+            virtual PreparedRequest const* get_Prepared() const { return nullptr; }
+
+            /// @brief called by the dispatcher right before performing the request, returning false skips it.
+            /// skipped requests aren't counted in the summary, but are still handed on like finished ones
+            virtual bool BeginDispatch() { return true; }
+
+            /// @brief traffic class to use instead of the downloader's, read while the request is going so it can be changed midway. if null the downloader's class is used
+            virtual std::atomic<TrafficClass> const* get_LiveTrafficClass() const { return nullptr; }
+
             __declspec(property(get=get_TargetResponse)) IResponse* TargetResponse;
             __declspec(property(get=get_URL)) URLOptions const& URL;
     };
@@ -26,10 +39,14 @@ namespace WebUtils {
     requires(std::is_default_constructible_v<T>)
     struct WEBUTILS_EXPORT GenericRequest : public IRequest {
         GenericRequest(URLOptions url) : url(url) {}
+        GenericRequest(std::shared_ptr<PreparedRequest const> prepared) : url(prepared->options()), prepared(std::move(prepared)) {}
         URLOptions url;
+        /// @brief optional prepared request, can be shared between many requests to the same url
+        std::shared_ptr<PreparedRequest const> prepared;
         T targetResponse{};
 
         virtual URLOptions const& get_URL() const override { return url; }
+        virtual PreparedRequest const* get_Prepared() const override { return prepared.get(); }
         virtual IResponse* get_TargetResponse() override { return &targetResponse; };
         virtual IResponse const* get_TargetResponse() const override { return &targetResponse; };
     };
@@ -42,9 +59,24 @@ namespace WebUtils {
 
             DownloaderUtility downloader{.userAgent = WEBUTILS_USER_AGENT, .timeOut = WEBUTILS_TIMEOUT};
 
+            /// @brief max amount of requests at once, over all hosts
             std::size_t maxConcurrentRequests = 1;
+            /// @brief minimum time between the starts of requests on each concurrent slot, over all hosts
             std::chrono::milliseconds rateLimitTime = std::chrono::milliseconds(0);
 
+            /// @brief concurrency & rate limit for requests to a single host
+            struct HostPolicy {
+                /// @brief max amount of requests at once to this host
+                std::size_t maxConcurrentRequests = 1;
+                /// @brief minimum time between the starts of requests on each concurrent slot of this host
+                std::chrono::milliseconds rateLimitTime = std::chrono::milliseconds(0);
+            };
+
+            /// @brief extra limits per origin, lowercase like "https://example.com". requests are queued per origin and
+            /// scheduled round robin, so a host waiting on its rate limit never holds up requests to other hosts.
+            /// maxConcurrentRequests & rateLimitTime still apply on top, hosts without a policy are only limited by those
+            std::unordered_map<std::string, HostPolicy> hostPolicies;
+
             /// @brief struct used for when a response is complete and it may need to be retried
             struct RetryOptions {
                 /// @brief time to wait before reattempting
@@ -57,10 +89,33 @@ namespace WebUtils {
             /// @return optional retry options. if set retries the request
             std::function<std::optional<RetryOptions>(bool success, IRequest* response)> onRequestFinished;
 
+            /// @brief summary of a full dispatch, for when finished requests aren't retained
+            struct DispatchSummary {
+                /// @brief amount of requests that were performed
+                std::size_t requestCount;
+                /// @brief amount of requests that were not successful on their last attempt
+                std::size_t failedCount;
+                /// @brief amount of retries done over all requests
+                std::size_t retryCount;
+                /// @brief time from the start of the dispatch until the last request finished
+                std::chrono::milliseconds duration;
+            };
+
+            /// @brief whether finished requests are kept until all requests are done, to be passed to allFinished.
+            /// if false every request is released right after onRequestFinished (or given to onRequestCompleted), keeping memory flat for big batches
+            bool retainFinishedRequests = true;
+
             /// @brief method invoked when all requests have been finished, including ones added while requests were going
-            /// @brief readonly span of the performed requests
+            /// @brief readonly span of the performed requests, empty if retainFinishedRequests is false
             std::function<void(std::span<std::unique_ptr<IRequest> const> requests)> allFinished;
 
+            /// @brief method invoked with ownership of a finished request when retainFinishedRequests is false.
+            /// if not set, the request is simply destroyed
+            std::function<void(std::unique_ptr<IRequest> request)> onRequestCompleted;
+
+            /// @brief method invoked when all requests have been finished, with a summary of the dispatch
+            std::function<void(DispatchSummary const& summary)> allFinishedSummary;
+
             /// @brief gets whether there are any requests to dispatch
             bool AnyRequestsToDispatch();
             /// @brief gets the size of the request queue
@@ -79,6 +134,12 @@ namespace WebUtils {
                 AddRequest(std::make_unique<GenericRequest<T>>(urlOptions));
             }
 
+            /// @brief adds a request using a prepared request onto the queue
+            template<response_impl T>
+            void AddRequest(std::shared_ptr<PreparedRequest const> prepared) {
+                AddRequest(std::make_unique<GenericRequest<T>>(std::move(prepared)));
+            }
+
             /// @brief adds all url options as T requests onto the queue
             /// @tparam response type to parse into
             /// @param options span of url options to use
@@ -101,16 +162,61 @@ namespace WebUtils {
 
             /// @brief method called when all requests have finished (queue empty)
             virtual void AllFinished(std::span<std::unique_ptr<IRequest> const> finishedRequests);
+
+            /// @brief method called with ownership of a finished request when requests are not retained
+            virtual void RequestCompleted(std::unique_ptr<IRequest> req);
+
+            /// @brief method called when all requests have finished (queue empty), with a summary of the dispatch
+            virtual void AllFinishedSummary(DispatchSummary const& summary);
         private:
+            /// @brief a single concurrent request, either of the dispatcher or of a host with a policy
+            struct Slot {
+                /// @brief whether a request is currently running in this slot
+                bool busy = false;
+                /// @brief when the rate limit allows the next request in this slot
+                std::chrono::steady_clock::time_point freeAt{};
+            };
+
+            /// @brief queue & slots for a single origin
+            struct HostQueue {
+                std::queue<std::unique_ptr<IRequest>> requests;
+                /// @brief only used if the host has a policy
+                std::vector<Slot> slots;
+            };
+
+            /// @brief request taken off the queue by a worker, together with the slots it runs in
+            struct ScheduledRequest {
+                std::unique_ptr<IRequest> request;
+                HostQueue* host;
+                std::size_t slot;
+                /// @brief slot of the host, nullopt if the host has no policy
+                std::optional<std::size_t> hostSlot;
+            };
+
             /// @brief mutex used to guard accesses to the requests queue
             std::shared_mutex _requestsMutex;
-            /// @brief queue used to store the requests to be done
-            std::queue<std::unique_ptr<IRequest>> _requestsToDispatch;
+            /// @brief notified when a request is added or a slot is released, for workers waiting to schedule
+            std::condition_variable_any _scheduleChanged;
+            /// @brief slots limiting requests over all hosts
+            std::vector<Slot> _slots;
+            /// @brief queues per origin, entries are never moved so pointers to them stay valid while dispatching
+            std::unordered_map<std::string, HostQueue> _hosts;
+            /// @brief order in which hosts get scheduled
+            std::vector<std::string> _hostOrder;
+            /// @brief index in _hostOrder of the host to try first when scheduling
+            std::size_t _nextHost = 0;
+            /// @brief total amount of queued requests over all hosts
+            std::size_t _queuedCount = 0;
             /// @brief mutex used to guard accesses to the finished requests vector
             std::shared_mutex _finishedMutex;
             /// @brief vector used to store finished requests
             std::vector<std::unique_ptr<IRequest>> _finishedRequests;
 
+            /// @brief counters for the summary of the current dispatch
+            std::atomic<std::size_t> _requestCount;
+            std::atomic<std::size_t> _failedCount;
+            std::atomic<std::size_t> _retryCount;
+
             /// @brief the currently executing dispatch
             std::shared_future<void> _currentRateLimitDispatch;
 
@@ -119,5 +225,15 @@ namespace WebUtils {
 
             /// @brief dispatcher worker
             void DispatchWorker();
+
+            /// @brief gets the policy of an origin, null if it has none
+            HostPolicy const* PolicyFor(std::string const& origin) const;
+
+            /// @brief pops the next request that's allowed to run, waiting for a slot or rate limit if needed
+            /// @return the request to run, nullopt if there are no requests left
+            std::optional<ScheduledRequest> ScheduleNext();
+
+            /// @brief marks the slot of a request as free again
+            void ReleaseSlot(ScheduledRequest const& scheduled);
     };
 }
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "./_config.h"
+#include <array>
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace WebUtils {
+    /// @brief when & how often failed requests are retried, with exponential backoff between attempts
+    struct WEBUTILS_EXPORT RetryPolicy {
+        /// @brief how often a failed request gets retried, 0 means never
+        std::size_t maxRetries = 0;
+        /// @brief delay before the first retry
+        std::chrono::milliseconds baseDelay{200};
+        /// @brief upper bound for any delay, including ones asked for by Retry-After
+        std::chrono::milliseconds maxDelay{10000};
+        /// @brief factor the delay grows with after every retry
+        double multiplier = 2.0;
+        /// @brief wait a random time between 0 & the backoff delay, so clients that failed together don't all retry together
+        bool jitter = true;
+        /// @brief wait at least as long as a Retry-After header (in seconds) on the response asks for
+        bool respectRetryAfter = true;
+        /// @brief curl codes worth retrying, by default resolve & connect failures, timeouts, partial & empty responses, send & receive errors
+        std::vector<int> retryCurlCodes{6, 7, 18, 28, 52, 55, 56};
+        /// @brief http codes worth retrying, by default timeouts, rate limits & temporary server errors
+        std::vector<int> retryHttpCodes{408, 429, 500, 502, 503, 504};
+
+        /// @brief whether a request that ended with these codes should be retried, ignoring maxRetries
+        bool ShouldRetry(int curlStatus, int httpCode) const noexcept;
+
+        /// @brief delay to wait before a retry
+        /// @param retry which retry this is, starting at 0
+        std::chrono::milliseconds Delay(std::size_t retry) const;
+    };
+
+    /// @brief when to send a duplicate of a GET that is taking unusually long, the first response to arrive is used
+    struct WEBUTILS_EXPORT HedgePolicy {
+        /// @brief percentile of earlier request latencies to the same host after which the duplicate is sent, 0 - 1
+        double percentile = 0.95;
+        /// @brief fixed delay after which the duplicate is sent, used instead of the percentile if set
+        std::optional<std::chrono::milliseconds> delay;
+        /// @brief samples needed for a host before the percentile is trusted, requests to hosts with less are not hedged
+        std::size_t minSamples = 20;
+        /// @brief lower bound of the delay, so requests to fast hosts aren't all sent twice
+        std::chrono::milliseconds minDelay{50};
+    };
+
+    /// @brief keeps the latencies of the last few successful requests per host
+    struct WEBUTILS_EXPORT LatencyTracker {
+        public:
+            /// @brief records the latency of a successful request
+            /// @param origin the origin of the request url, see URLOptions::origin
+            void Record(std::string_view origin, std::chrono::microseconds latency);
+
+            /// @brief gets a latency percentile of the recorded requests to a host
+            /// @param origin the origin of the request url, see URLOptions::origin
+            /// @param percentile the percentile to get, 0 - 1
+            /// @param minSamples how many samples are needed for a result
+            /// @return the percentile, or nullopt if there are not enough samples
+            std::optional<std::chrono::microseconds> Percentile(std::string_view origin, double percentile, std::size_t minSamples) const;
+        private:
+            struct Samples {
+                std::array<std::chrono::microseconds, WEBUTILS_LATENCY_SAMPLES> ring{};
+                std::size_t count = 0;
+            };
+
+            mutable std::mutex _mutex;
+            std::unordered_map<std::string, Samples> _hosts;
+    };
+}
@@ -0,0 +1,236 @@
+#pragma once
+
+#include "./_config.h"
+#include "./DownloaderUtility.hpp"
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <concepts>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace WebUtils {
+    namespace detail {
+        /// @brief string usable as a template argument, so patterns can be parsed at compile time
+        template<std::size_t N>
+        struct FixedString {
+            char value[N]{};
+            constexpr FixedString(char const (&str)[N]) { std::copy_n(str, N, value); }
+            constexpr std::string_view view() const { return {value, N - 1}; }
+        };
+
+        /// @brief not constexpr on purpose, calling it while parsing a route makes the compile fail with the message visible
+        inline void invalid_route_pattern(char const*) {}
+
+        constexpr bool isUnreserved(char c) {
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '.' || c == '_' || c == '~';
+        }
+
+        constexpr bool isReserved(char c) {
+            return std::string_view(":/?#[]@!$&'()*+,;=").find(c) != std::string_view::npos;
+        }
+
+        /// @brief static parts of a route keep their url structure, only characters that are never valid get escaped
+        constexpr bool needsStaticEscape(char c) { return !isUnreserved(c) && !isReserved(c) && c != '%'; }
+
+        /// @brief dynamic parts of a route are single components, so everything but unreserved characters gets escaped
+        constexpr bool needsDynamicEscape(char c) { return !isUnreserved(c); }
+
+        constexpr char nibbleToChar(uint8_t nibble) { return "0123456789ABCDEF"[nibble & 0b1111]; }
+
+        enum class PlaceholderType {
+            /// @brief {name}, any supported type
+            Any,
+            /// @brief {name:int}, integral types only
+            Integer,
+            /// @brief {name:str}, string types only
+            String,
+        };
+
+        template<FixedString Pattern>
+        struct ParsedRoute {
+            static constexpr std::string_view pattern = Pattern.view();
+
+            static consteval std::size_t countPlaceholders() {
+                std::size_t count = 0;
+                bool open = false;
+                for (auto c : pattern) {
+                    if (c == '{') {
+                        if (open) invalid_route_pattern("nested '{' in route pattern");
+                        open = true;
+                    } else if (c == '}') {
+                        if (!open) invalid_route_pattern("unmatched '}' in route pattern");
+                        open = false;
+                        count++;
+                    }
+                }
+                if (open) invalid_route_pattern("unterminated '{' in route pattern");
+                return count;
+            }
+
+            static constexpr std::size_t placeholderCount = countPlaceholders();
+
+            /// @brief length of all static parts together after escaping
+            static consteval std::size_t countStaticLength() {
+                std::size_t length = 0;
+                bool open = false;
+                for (auto c : pattern) {
+                    if (c == '{') open = true;
+                    else if (c == '}') open = false;
+                    else if (!open) length += needsStaticEscape(c) ? 3 : 1;
+                }
+                return length;
+            }
+
+            static constexpr std::size_t staticLength = countStaticLength();
+
+            struct Parts {
+                /// @brief all escaped static parts after each other
+                std::array<char, staticLength + 1> statics{};
+                /// @brief where each static part starts in statics, static part i sits between offsets i & i + 1
+                std::array<std::size_t, placeholderCount + 2> offsets{};
+                std::array<PlaceholderType, placeholderCount + 1> types{};
+            };
+
+            static consteval Parts parse() {
+                Parts parts;
+                std::size_t length = 0, placeholder = 0, nameStart = 0;
+                bool open = false;
+                for (std::size_t i = 0; i < pattern.size(); i++) {
+                    auto c = pattern[i];
+                    if (c == '{') {
+                        open = true;
+                        nameStart = i + 1;
+                    } else if (c == '}') {
+                        // find the type after the ':', by hand as not every compiler allows find on the pattern in constant expressions
+                        auto colon = nameStart;
+                        while (colon < i && pattern[colon] != ':') colon++;
+                        auto type = colon < i ? pattern.substr(colon + 1, i - colon - 1) : std::string_view();
+                        if (type.empty()) parts.types[placeholder] = PlaceholderType::Any;
+                        else if (type == "int") parts.types[placeholder] = PlaceholderType::Integer;
+                        else if (type == "str") parts.types[placeholder] = PlaceholderType::String;
+                        else invalid_route_pattern("unknown placeholder type in route pattern, use int or str");
+
+                        open = false;
+                        placeholder++;
+                        parts.offsets[placeholder] = length;
+                    } else if (!open) {
+                        if (needsStaticEscape(c)) {
+                            parts.statics[length++] = '%';
+                            parts.statics[length++] = nibbleToChar(static_cast<uint8_t>(c) >> 4);
+                            parts.statics[length++] = nibbleToChar(static_cast<uint8_t>(c));
+                        } else {
+                            parts.statics[length++] = c;
+                        }
+                    }
+                }
+                parts.offsets[placeholderCount + 1] = length;
+                return parts;
+            }
+
+            static constexpr Parts parts = parse();
+
+            static constexpr std::string_view staticPart(std::size_t index) {
+                return std::string_view(parts.statics.data() + parts.offsets[index], parts.offsets[index + 1] - parts.offsets[index]);
+            }
+        };
+
+        template<typename T>
+        concept route_integer = std::integral<std::remove_cvref_t<T>> && !std::is_same_v<std::remove_cvref_t<T>, bool>;
+
+        template<typename T>
+        concept route_string = std::convertible_to<T const&, std::string_view>;
+
+        template<typename T>
+        concept route_argument = route_integer<T> || route_string<T>;
+
+        template<typename T>
+        constexpr bool matchesPlaceholder(PlaceholderType type) {
+            switch (type) {
+                case PlaceholderType::Integer: return route_integer<T>;
+                case PlaceholderType::String: return route_string<T>;
+                default: return route_argument<T>;
+            }
+        }
+
+        template<typename Parsed, typename... Args, std::size_t... I>
+        consteval bool argumentsMatch(std::index_sequence<I...>) {
+            return (matchesPlaceholder<Args>(Parsed::parts.types[I]) && ...);
+        }
+
+        /// @brief upper bound of the size of an argument after escaping
+        template<route_argument T>
+        constexpr std::size_t maxEscapedSize(T const& arg) {
+            if constexpr (route_integer<T>) return std::numeric_limits<std::remove_cvref_t<T>>::digits10 + 2;
+            else return std::string_view(arg).size() * 3;
+        }
+
+        template<route_argument T>
+        void appendEscaped(std::string& out, T const& arg) {
+            if constexpr (route_integer<T>) {
+                // digits and '-' never need escaping
+                char buffer[std::numeric_limits<std::remove_cvref_t<T>>::digits10 + 2];
+                auto [end, ec] = std::to_chars(std::begin(buffer), std::end(buffer), arg);
+                out.append(buffer, end);
+            } else {
+                for (auto c : std::string_view(arg)) {
+                    if (needsDynamicEscape(c)) {
+                        out.push_back('%');
+                        out.push_back(nibbleToChar(static_cast<uint8_t>(c) >> 4));
+                        out.push_back(nibbleToChar(static_cast<uint8_t>(c)));
+                    } else {
+                        out.push_back(c);
+                    }
+                }
+            }
+        }
+    }
+
+    /// @brief url pattern parsed & escaped at compile time, like "https://example.com/api/maps/{hash}/scores?page={page:int}".
+    /// placeholders are written as {name}, optionally typed as {name:int} or {name:str}.
+    /// the amount & types of arguments are checked at compile time, at runtime only the arguments get escaped & spliced in
+    template<detail::FixedString Pattern>
+    struct Route {
+        private:
+            using Parsed = detail::ParsedRoute<Pattern>;
+
+            template<typename... Args>
+            static consteval bool checkArguments() {
+                if constexpr (sizeof...(Args) != Parsed::placeholderCount) return false;
+                else return detail::argumentsMatch<Parsed, Args...>(std::index_sequence_for<Args...>{});
+            }
+
+            template<typename... Args>
+            static constexpr bool validArguments = checkArguments<Args...>();
+        public:
+            /// @brief the amount of placeholders in the pattern
+            static constexpr std::size_t placeholderCount = Parsed::placeholderCount;
+
+            /// @brief formats the url with the given arguments
+            /// @return the escaped url
+            template<detail::route_argument... Args>
+            requires(validArguments<Args...>)
+            static std::string Format(Args const&... args) {
+                std::string url;
+                url.reserve(Parsed::staticLength + (detail::maxEscapedSize(args) + ... + 0));
+
+                std::size_t index = 0;
+                ((url.append(Parsed::staticPart(index++)), detail::appendEscaped(url, args)), ...);
+                url.append(Parsed::staticPart(index));
+                return url;
+            }
+
+            /// @brief creates url options for the route with the given arguments, already escaped so noEscape is set
+            /// @return url options to use for requests
+            template<detail::route_argument... Args>
+            requires(validArguments<Args...>)
+            static URLOptions Options(Args const&... args) {
+                URLOptions options(Format(args...));
+                options.noEscape = true;
+                return options;
+            }
+    };
+}
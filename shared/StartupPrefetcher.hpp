@@ -0,0 +1,83 @@
+#pragma once
+
+#include "./_config.h"
+#include "./DownloaderUtility.hpp"
+#include "./RatelimitedDispatcher.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace WebUtils {
+    /// @brief records the urls requested at startup into a manifest on disk, & prefetches them as background traffic on the next startup.
+    /// downloaders claim prefetched responses for their foreground GET requests, so the ui gets responses that already arrived or are in flight
+    struct WEBUTILS_EXPORT StartupPrefetcher {
+        public:
+            StartupPrefetcher();
+            /// @brief skips prefetches that didn't start yet & waits for the ones in flight
+            virtual ~StartupPrefetcher();
+
+            StartupPrefetcher(StartupPrefetcher const&) = delete;
+            StartupPrefetcher& operator=(StartupPrefetcher const&) = delete;
+
+            /// @brief the prefetcher used by downloaders that don't have their own, does nothing until started. never destroyed
+            static StartupPrefetcher& Default();
+
+            /// @brief dispatcher the prefetches go through, its request callbacks are used by the prefetcher.
+            /// its downloader is background traffic & has to stay that way, a foreground one would wait on its own prefetches
+            RatelimitedDispatcher dispatcher;
+            /// @brief how long after arriving a prefetched response may still be handed out
+            std::chrono::seconds maxAge = std::chrono::seconds(60);
+
+            /// @brief prefetches the urls recorded last time, then records the urls requested during this startup in their place.
+            /// urls with a query string aren't recorded, query strings tend to carry tokens that shouldn't end up on disk
+            /// @param manifestPath file the urls are kept in, created if it doesn't exist
+            /// @param startupDuration how long after starting requests still count as startup requests
+            void Start(std::filesystem::path manifestPath, std::chrono::seconds startupDuration = std::chrono::seconds(30));
+
+            /// @brief stops recording early, the manifest keeps the urls recorded so far
+            void StopRecording();
+
+            /// @brief records a request if startup is still going, & takes its prefetched response if there is one.
+            /// waits up to the request's timeout for a prefetch that's in flight, raising it to foreground traffic meanwhile. one that didn't start yet is skipped & left to the caller.
+            /// prefetches are only handed to requests with the same useSSL, encoding & user agent they were made with.
+            /// requests with headers are ignored, headers tend to carry credentials that shouldn't end up on disk
+            /// @return the prefetched response, nullopt if the caller should do the request itself
+            std::optional<TransferResult> Claim(PreparedRequest const& prepared);
+        private:
+            struct Prefetch;
+            struct PrefetchRequest;
+
+            /// @brief whether Start was called, checked without the mutex since most requests happen when nothing is prefetched
+            std::atomic<bool> _started = false;
+
+            /// @brief mutex guarding everything below
+            std::mutex _mutex;
+            /// @brief notified when a prefetch finishes
+            std::condition_variable _prefetchDone;
+            bool _stopping = false;
+            /// @brief prefetches that weren't claimed yet, by escaped url
+            std::unordered_map<std::string, std::shared_ptr<Prefetch>> _prefetches;
+            std::ofstream _manifest;
+            std::unordered_set<std::string> _recorded;
+            std::chrono::steady_clock::time_point _recordUntil;
+            std::shared_future<void> _dispatch;
+
+            /// @brief appends a request to the manifest if its url is new & startup is still going, call with the mutex held
+            void Record(PreparedRequest const& prepared);
+
+            /// @brief marks a prefetch as running, unless it was claimed or the prefetcher is stopping
+            bool BeginPrefetch(Prefetch& prefetch);
+
+            /// @brief stores the result of a finished prefetch
+            void PrefetchCompleted(PrefetchRequest& request);
+    };
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "./_config.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace WebUtils {
+    /// @brief fixed size work stealing thread pool. every worker has its own queue, idle workers take work from the others.
+    /// tasks submitted from a worker go on that worker's queue, so follow up work stays on the thread that made it
+    struct WEBUTILS_EXPORT ThreadPool {
+        public:
+            /// @param threadCount amount of worker threads, at least 1. threads start when the first task is queued
+            explicit ThreadPool(std::size_t threadCount = WEBUTILS_THREAD_POOL_SIZE);
+            /// @brief runs every queued task, then joins the workers. must not be destroyed from one of its own tasks
+            ~ThreadPool();
+
+            ThreadPool(ThreadPool const&) = delete;
+            ThreadPool& operator=(ThreadPool const&) = delete;
+
+            /// @brief the pool used by downloaders that don't have their own, never destroyed
+            static ThreadPool& Default();
+
+            /// @brief amount of worker threads
+            std::size_t size() const noexcept { return _queues.size(); }
+
+            /// @brief whether the calling thread is one of this pool's workers
+            bool IsWorkerThread() const noexcept;
+
+            /// @brief queues a task without a way to get its result, exceptions it throws are logged & dropped
+            template<typename F>
+            void Enqueue(F&& func) {
+                // std::function needs copyable callables, tasks may hold move only things like upload sources
+                auto task = std::make_shared<std::decay_t<F>>(std::forward<F>(func));
+                Push([task]() { (*task)(); });
+            }
+
+            /// @brief queues a task
+            /// @return future for the result of the task, unlike std::async it does not block when destroyed
+            template<typename F>
+            auto Submit(F&& func) -> std::future<std::invoke_result_t<std::decay_t<F>&>> {
+                using Result = std::invoke_result_t<std::decay_t<F>&>;
+                auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(func));
+                auto future = task->get_future();
+                Push([task]() { (*task)(); });
+                return future;
+            }
+        private:
+            struct Queue {
+                std::mutex mutex;
+                std::deque<std::function<void()>> tasks;
+            };
+
+            void Push(std::function<void()> task);
+            void StartWorkers();
+            void WorkerThread(std::size_t index);
+            /// @brief takes a task from the worker's own queue, or steals one from another queue
+            bool TryTake(std::size_t index, std::function<void()>& task);
+
+            std::vector<std::unique_ptr<Queue>> _queues;
+            std::vector<std::thread> _threads;
+            std::once_flag _started;
+            /// @brief queue external submissions go to next, spreads them over the workers
+            std::atomic<std::size_t> _nextQueue = 0;
+            /// @brief tasks queued but not taken yet, workers sleep while this is 0
+            std::atomic<std::size_t> _pending = 0;
+            std::mutex _sleepMutex;
+            std::condition_variable _wake;
+            bool _stopping = false;
+    };
+}
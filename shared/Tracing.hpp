@@ -0,0 +1,78 @@
+#pragma once
+
+#include "./_config.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+
+namespace WebUtils::Tracing {
+    using clock = std::chrono::steady_clock;
+
+    namespace detail {
+        WEBUTILS_EXPORT extern std::atomic<bool> enabled;
+
+        /// @brief records without checking whether tracing is enabled, the inline wrappers check that so disabled tracing doesn't cost a call
+        WEBUTILS_EXPORT void RecordSpan(char const* name, char const* category, clock::time_point start, clock::time_point end, uint64_t id);
+        WEBUTILS_EXPORT void RecordInstant(char const* name, char const* category, uint64_t id);
+    }
+
+    /// @brief enables or disables recording trace events. while disabled, recording is a single atomic load
+    WEBUTILS_EXPORT void Enable(bool enabled = true);
+
+    /// @brief whether trace events are being recorded
+    inline bool IsEnabled() noexcept { return detail::enabled.load(std::memory_order_relaxed); }
+
+    /// @brief records a span from start to end on the calling thread
+    /// @param name name of the span, has to be a string that lives forever (literal)
+    /// @param category category of the span, has to be a string that lives forever (literal)
+    /// @param id id to correlate spans of the same request across threads, 0 for none
+    inline void RecordSpan(char const* name, char const* category, clock::time_point start, clock::time_point end, uint64_t id = 0) {
+        if (IsEnabled()) detail::RecordSpan(name, category, start, end, id);
+    }
+
+    /// @brief records a single point in time on the calling thread
+    /// @param name name of the event, has to be a string that lives forever (literal)
+    /// @param category category of the event, has to be a string that lives forever (literal)
+    /// @param id id to correlate events of the same request across threads, 0 for none
+    inline void RecordInstant(char const* name, char const* category, uint64_t id = 0) {
+        if (IsEnabled()) detail::RecordInstant(name, category, id);
+    }
+
+    /// @brief writes all recorded events as chrome trace event json, viewable in chrome://tracing or perfetto
+    WEBUTILS_EXPORT void WriteChromeTrace(std::ostream& out);
+
+    /// @brief writes all recorded events as chrome trace event json to a file
+    /// @return whether the file could be written
+    WEBUTILS_EXPORT bool WriteChromeTrace(std::filesystem::path const& path);
+
+    /// @brief forgets all events recorded so far
+    WEBUTILS_EXPORT void Clear();
+
+    /// @brief records a span for as long as it lives, if tracing was enabled when it got created
+    struct WEBUTILS_EXPORT ScopedSpan {
+        public:
+            /// @param name name of the span, has to be a string that lives forever (literal)
+            /// @param category category of the span, has to be a string that lives forever (literal)
+            /// @param id id to correlate spans of the same request across threads, 0 for none
+            ScopedSpan(char const* name, char const* category, uint64_t id = 0) noexcept : _name(name), _category(category), _id(id) {
+                if (IsEnabled()) _start = clock::now();
+            }
+
+            ~ScopedSpan() {
+                if (_start != clock::time_point{}) RecordSpan(_name, _category, _start, clock::now(), _id);
+            }
+
+            ScopedSpan(ScopedSpan const&) = delete;
+            ScopedSpan& operator=(ScopedSpan const&) = delete;
+        private:
+            char const* _name;
+            char const* _category;
+            uint64_t _id;
+            clock::time_point _start{};
+    };
+
+    /// @brief id to correlate trace events of a request, based on its address
+    inline uint64_t IdOf(void const* ptr) noexcept { return reinterpret_cast<uintptr_t>(ptr); }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "./_config.h"
+#include "./UploadSource.hpp"
+#include "./BandwidthLimiter.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace WebUtils {
+    struct PreparedRequest;
+
+    /// @brief a single request for a transport to perform, everything about it is already resolved
+    struct WEBUTILS_EXPORT TransferRequest {
+        /// @brief the prepared url, headers, user agent & timeout
+        PreparedRequest const& prepared;
+        /// @brief http method, "GET" or "POST"
+        std::string_view method = "GET";
+        /// @brief headers to send on top of the prepared ones, formatted like "Content-Type: application/json"
+        std::span<std::string const> extraHeaders{};
+        /// @brief body to send, read while the request is going. null for no body
+        IUploadSource* body = nullptr;
+        /// @brief progress callback as a float from 0 - 1, upload progress if there is a body, download progress otherwise. allowed to be null or empty
+        std::function<void(float)> const* progressReport = nullptr;
+        /// @brief id to correlate trace events of the request
+        uint64_t traceId = 0;
+        /// @brief limiter every sent & received byte has to go through, null for unlimited
+        BandwidthLimiter* limiter = nullptr;
+        /// @brief traffic class the limiter treats the transfer as
+        TrafficClass trafficClass = TrafficClass::Foreground;
+        /// @brief if set, used instead of trafficClass & read again for every chunk, so the class can change while the transfer is going
+        std::atomic<TrafficClass> const* liveTrafficClass = nullptr;
+
+        /// @brief the traffic class the transfer has right now
+        TrafficClass CurrentTrafficClass() const noexcept { return liveTrafficClass ? liveTrafficClass->load(std::memory_order_relaxed) : trafficClass; }
+    };
+
+    /// @brief what came back from performing a request
+    struct WEBUTILS_EXPORT TransferResult {
+        /// @brief curl code of the transfer, transports not using curl report the closest matching one
+        int curlStatus = 0;
+        /// @brief http code of the response, 0 if there was none
+        int httpCode = 0;
+        /// @brief the response body
+        std::vector<uint8_t> data;
+        /// @brief the raw response headers
+        std::string headers;
+        /// @brief how long the transfer took, for hedged requests from the start of the first attempt
+        std::chrono::microseconds latency{0};
+    };
+
+    /// @brief performs requests for a downloader, swappable so requests can go somewhere other than the network
+    struct WEBUTILS_EXPORT ITransport {
+        public:
+            virtual ~ITransport() = default;
+
+            /// @brief performs a request, blocking until it is done
+            virtual TransferResult Perform(TransferRequest const& request) = 0;
+
+            /// @brief performs a request without a body, sending a duplicate once it takes longer than hedgeDelay. the first successful response wins.
+            /// by default no duplicate is sent
+            virtual TransferResult PerformHedged(TransferRequest const& request, std::chrono::microseconds /*hedgeDelay*/) { return Perform(request); }
+    };
+
+    /// @brief transport doing real requests through libcurl, the default for every downloader
+    struct WEBUTILS_EXPORT CurlTransport : public ITransport {
+        public:
+            /// @brief the transport used by downloaders that don't have one set
+            static CurlTransport& Default();
+
+            virtual TransferResult Perform(TransferRequest const& request) override;
+
+            /// @brief both attempts run on one curl multi handle, so hedging doesn't take an extra thread
+            virtual TransferResult PerformHedged(TransferRequest const& request, std::chrono::microseconds hedgeDelay) override;
+    };
+}
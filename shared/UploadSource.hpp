@@ -0,0 +1,143 @@
+#pragma once
+
+#include "./_config.h"
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace WebUtils {
+    /// @brief pull based source of data to upload, read piece by piece while the request is being sent
+    /// this means the data to send never has to be in memory as a whole
+    class WEBUTILS_EXPORT IUploadSource {
+        public:
+            virtual ~IUploadSource() = default;
+
+            /// @brief reads the next part of the data into buffer
+            /// @param buffer buffer to fill, reading less than its size is allowed
+            /// @return amount of bytes read, 0 means the end of the data was reached, nullopt means an error happened and the upload should abort
+            virtual std::optional<std::size_t> Read(std::span<uint8_t> buffer) = 0;
+
+            /// @brief total size of the data if known. if not known, the data gets sent with chunked transfer encoding
+            virtual std::optional<std::size_t> Size() const { return std::nullopt; }
+
+            /// @brief content type of the data, if set it's sent as the Content-Type header
+            virtual std::optional<std::string> ContentType() const { return std::nullopt; }
+
+            /// @brief go back to the start of the data, used when a request has to be resent (redirects)
+            /// @return whether rewinding is supported & succeeded
+            virtual bool Rewind() { return false; }
+    };
+
+    /// @brief upload source reading from a span of data, the data has to outlive the upload!
+    struct WEBUTILS_EXPORT SpanUploadSource : public IUploadSource {
+        public:
+            SpanUploadSource(std::span<uint8_t const> data) : _data(data) {}
+
+            virtual std::optional<std::size_t> Read(std::span<uint8_t> buffer) override;
+            virtual std::optional<std::size_t> Size() const override { return _data.size(); }
+            virtual bool Rewind() override { _offset = 0; return true; }
+        private:
+            std::span<uint8_t const> _data;
+            std::size_t _offset = 0;
+    };
+
+    /// @brief upload source reading from an istream, the stream has to outlive the upload!
+    struct WEBUTILS_EXPORT StreamUploadSource : public IUploadSource {
+        public:
+            /// @param stream stream to read from, read from its current position
+            /// @param size size of the data in the stream if known
+            StreamUploadSource(std::istream& stream, std::optional<std::size_t> size = std::nullopt);
+
+            virtual std::optional<std::size_t> Read(std::span<uint8_t> buffer) override;
+            virtual std::optional<std::size_t> Size() const override { return _size; }
+            virtual bool Rewind() override;
+        private:
+            std::istream& _stream;
+            std::istream::pos_type _start;
+            std::optional<std::size_t> _size;
+    };
+
+    /// @brief upload source reading a file from disk
+    struct WEBUTILS_EXPORT FileUploadSource : public IUploadSource {
+        public:
+            FileUploadSource(std::filesystem::path const& path);
+
+            /// @brief whether the file could be opened
+            bool valid() const noexcept { return _file.is_open(); }
+
+            virtual std::optional<std::size_t> Read(std::span<uint8_t> buffer) override;
+            virtual std::optional<std::size_t> Size() const override;
+            virtual bool Rewind() override;
+        private:
+            std::ifstream _file;
+            std::optional<std::size_t> _size;
+    };
+
+    /// @brief upload source calling a method to get the data
+    struct WEBUTILS_EXPORT CallbackUploadSource : public IUploadSource {
+        public:
+            using ReadCallback = std::function<std::optional<std::size_t>(std::span<uint8_t> buffer)>;
+
+            /// @param onRead method called to fill the given buffer, see IUploadSource::Read
+            /// @param size size of the data if known
+            /// @param onRewind method called to go back to the start of the data, allowed to be null
+            CallbackUploadSource(ReadCallback onRead, std::optional<std::size_t> size = std::nullopt, std::function<bool()> onRewind = nullptr) : _onRead(std::move(onRead)), _size(size), _onRewind(std::move(onRewind)) {}
+
+            virtual std::optional<std::size_t> Read(std::span<uint8_t> buffer) override { return _onRead ? _onRead(buffer) : std::nullopt; }
+            virtual std::optional<std::size_t> Size() const override { return _size; }
+            virtual bool Rewind() override { return _onRewind && _onRewind(); }
+        private:
+            ReadCallback _onRead;
+            std::optional<std::size_t> _size;
+            std::function<bool()> _onRewind;
+    };
+
+    /// @brief upload source sending multipart/form-data, streaming every part from its own source
+    struct WEBUTILS_EXPORT MultipartUploadSource : public IUploadSource {
+        public:
+            /// @param boundary boundary between parts, if empty a random one is generated
+            MultipartUploadSource(std::string boundary = "");
+
+            /// @brief adds a simple text field
+            /// @return false if the body was already read from, parts can't be added after that
+            bool AddField(std::string_view name, std::string_view value);
+
+            /// @brief adds a part with its data read from source
+            /// @param name form field name
+            /// @param source the data for this part
+            /// @param fileName file name to report for this part, if any
+            /// @param contentType content type of this part
+            /// @return false if source is null or the body was already read from, parts can't be added after that
+            bool AddPart(std::string_view name, std::unique_ptr<IUploadSource> source, std::optional<std::string_view> fileName = std::nullopt, std::string_view contentType = "application/octet-stream");
+
+            /// @brief adds a file as a part, reading it from disk while uploading
+            /// @return false if the body was already read from, parts can't be added after that
+            bool AddFile(std::string_view name, std::filesystem::path const& path, std::string_view contentType = "application/octet-stream");
+
+            virtual std::optional<std::size_t> Read(std::span<uint8_t> buffer) override;
+            virtual std::optional<std::size_t> Size() const override;
+            virtual std::optional<std::string> ContentType() const override;
+            virtual bool Rewind() override;
+        private:
+            using Segment = std::variant<std::string, std::unique_ptr<IUploadSource>>;
+
+            std::string _boundary;
+            /// @brief pieces of the body, strings for the boundaries and part headers, sources for the part data
+            std::vector<Segment> _segments;
+            /// @brief whether the closing boundary was added already
+            bool _closed = false;
+            std::size_t _segmentIndex = 0;
+            std::size_t _segmentOffset = 0;
+
+            /// @brief adds the closing boundary if not yet done
+            void Close();
+    };
+}
@@ -8,6 +8,13 @@
 namespace WebUtils {
     static WEBUTILS_EXPORT DownloaderUtility const downloader{.userAgent = WEBUTILS_USER_AGENT, .timeOut = WEBUTILS_TIMEOUT};
 
+    /// @brief prepares a request with the default user agent & timeout, reusable for repeated requests to the same url
+    /// @param urlOptions url options to prepare
+    /// @return prepared request
+    inline PreparedRequest WEBUTILS_EXPORT Prepare(URLOptions urlOptions) {
+        return downloader.Prepare(std::forward<URLOptions>(urlOptions));
+    }
+
 #pragma region GET
     /// @brief runs a get request asynchronously
     /// @tparam T the response type to output
@@ -41,6 +48,17 @@ namespace WebUtils {
     inline T WEBUTILS_EXPORT Get(URLOptions urlOptions, std::function<void(float)> progressReport = nullptr) {
         return downloader.Get<T>(std::forward<URLOptions>(urlOptions), std::forward<std::function<void(float)>>(progressReport));
     }
+
+    /// @brief runs a get request synchronously using a prepared request
+    /// @tparam T the response type to output
+    /// @param prepared the prepared request to use
+    /// @param progressReport progress callback as a float from 0 - 1, allowed to be null
+    /// @return response
+    template<response_impl T>
+    requires(std::is_default_constructible_v<T>)
+    inline T WEBUTILS_EXPORT Get(PreparedRequest const& prepared, std::function<void(float)> progressReport = nullptr) {
+        return downloader.Get<T>(prepared, std::forward<std::function<void(float)>>(progressReport));
+    }
 #pragma endregion // GET
 
 #pragma region POST
@@ -53,7 +71,7 @@ namespace WebUtils {
     template<response_impl T>
     requires(std::is_default_constructible_v<T>)
     inline std::future<T> WEBUTILS_EXPORT PostAsync(URLOptions urlOptions, std::span<uint8_t const> data, std::function<void(float)> progressReport = nullptr) {
-        return downloader.PostAsync<T>(std::forward<URLOptions>(urlOptions), std::forward<std::function<void(float)>>(progressReport));
+        return downloader.PostAsync<T>(std::forward<URLOptions>(urlOptions), std::forward<std::span<uint8_t const>>(data), std::forward<std::function<void(float)>>(progressReport));
     }
 
     /// @brief runs a get request asynchronously, calling onFinished when done
@@ -65,7 +83,7 @@ namespace WebUtils {
     template<response_impl T>
     requires(std::is_default_constructible_v<T>)
     inline void WEBUTILS_EXPORT PostAsync(URLOptions urlOptions, std::span<uint8_t const> data, std::function<void(T)> onFinished, std::function<void(float)> progressReport = nullptr) {
-        downloader.PostAsync<T>(std::forward<URLOptions>(urlOptions), std::forward<std::function<void(T)>>(onFinished), std::forward<std::function<void(float)>>(progressReport));
+        downloader.PostAsync<T>(std::forward<URLOptions>(urlOptions), std::forward<std::span<uint8_t const>>(data), std::forward<std::function<void(T)>>(onFinished), std::forward<std::function<void(float)>>(progressReport));
     }
 
     /// @brief runs a get request synchronously
@@ -77,7 +95,43 @@ namespace WebUtils {
     template<response_impl T>
     requires(std::is_default_constructible_v<T>)
     inline T WEBUTILS_EXPORT Post(URLOptions urlOptions, std::span<uint8_t const> data, std::function<void(float)> progressReport = nullptr) {
-        return downloader.Post<T>(std::forward<URLOptions>(urlOptions), std::forward<std::function<void(float)>>(progressReport));
+        return downloader.Post<T>(std::forward<URLOptions>(urlOptions), std::forward<std::span<uint8_t const>>(data), std::forward<std::function<void(float)>>(progressReport));
+    }
+
+    /// @brief runs a post request asynchronously, streaming the data from a source
+    /// @tparam T the response type to output
+    /// @param urlOptions url options to pass to curl
+    /// @param source the data to send, owned by the request
+    /// @param progressReport progress callback as a float from 0 - 1, allowed to be null
+    /// @return future response
+    template<response_impl T>
+    requires(std::is_default_constructible_v<T>)
+    inline std::future<T> WEBUTILS_EXPORT PostAsync(URLOptions urlOptions, std::unique_ptr<IUploadSource> source, std::function<void(float)> progressReport = nullptr) {
+        return downloader.PostAsync<T>(std::forward<URLOptions>(urlOptions), std::move(source), std::forward<std::function<void(float)>>(progressReport));
+    }
+
+    /// @brief runs a post request asynchronously, streaming the data from a source, calling onFinished when done
+    /// @tparam T the response type to output
+    /// @param urlOptions url options to pass to curl
+    /// @param source the data to send, owned by the request
+    /// @param onFinished function to run when done, NOT RAN ON MAIN OR BOUND IL2CPP THREAD
+    /// @param progressReport progress callback as a float from 0 - 1, allowed to be null
+    template<response_impl T>
+    requires(std::is_default_constructible_v<T>)
+    inline void WEBUTILS_EXPORT PostAsync(URLOptions urlOptions, std::unique_ptr<IUploadSource> source, std::function<void(T)> onFinished, std::function<void(float)> progressReport = nullptr) {
+        downloader.PostAsync<T>(std::forward<URLOptions>(urlOptions), std::move(source), std::forward<std::function<void(T)>>(onFinished), std::forward<std::function<void(float)>>(progressReport));
+    }
+
+    /// @brief runs a post request synchronously, streaming the data from a source
+    /// @tparam T the response type to output
+    /// @param urlOptions url options to pass to curl
+    /// @param source the data to send, read while the request is going
+    /// @param progressReport progress callback as a float from 0 - 1, allowed to be null
+    /// @return response
+    template<response_impl T>
+    requires(std::is_default_constructible_v<T>)
+    inline T WEBUTILS_EXPORT Post(URLOptions urlOptions, IUploadSource& source, std::function<void(float)> progressReport = nullptr) {
+        return downloader.Post<T>(std::forward<URLOptions>(urlOptions), source, std::forward<std::function<void(float)>>(progressReport));
     }
 #pragma endregion // POST
 }
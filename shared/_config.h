@@ -41,3 +41,43 @@
 #ifndef WEBUTILS_MAX_CONCURRENCY
 #define WEBUTILS_MAX_CONCURRENCY (std::size_t(8))
 #endif
+
+// zlib level used for compressed request bodies
+#ifndef WEBUTILS_COMPRESSION_LEVEL
+#define WEBUTILS_COMPRESSION_LEVEL 6
+#endif
+
+// amount of trace events kept per thread when tracing is enabled
+#ifndef WEBUTILS_TRACE_BUFFER_SIZE
+#define WEBUTILS_TRACE_BUFFER_SIZE (std::size_t(4096))
+#endif
+
+// amount of request latencies kept per host, used to decide when to hedge
+#ifndef WEBUTILS_LATENCY_SAMPLES
+#define WEBUTILS_LATENCY_SAMPLES (std::size_t(64))
+#endif
+
+// worker threads of the default thread pool, used for async requests
+#ifndef WEBUTILS_THREAD_POOL_SIZE
+#define WEBUTILS_THREAD_POOL_SIZE (std::size_t(8))
+#endif
+
+// resolution of the timer wheel polls are scheduled on, polls go out at most this much late
+#ifndef WEBUTILS_POLL_TICK
+#define WEBUTILS_POLL_TICK (std::chrono::milliseconds(50))
+#endif
+
+// slots of the timer wheel polls are scheduled on, polls further out than a full turn wait for more turns
+#ifndef WEBUTILS_POLL_WHEEL_SLOTS
+#define WEBUTILS_POLL_WHEEL_SLOTS (std::size_t(512))
+#endif
+
+// worker threads of the pool every poller runs its polls on by default
+#ifndef WEBUTILS_POLL_POOL_SIZE
+#define WEBUTILS_POLL_POOL_SIZE (std::size_t(8))
+#endif
+
+// max amount of urls a startup prefetch manifest keeps
+#ifndef WEBUTILS_PREFETCH_MAX_URLS
+#define WEBUTILS_PREFETCH_MAX_URLS (std::size_t(64))
+#endif
@@ -0,0 +1,70 @@
+#include "BandwidthLimiter.hpp"
+
+#include <algorithm>
+#include <thread>
+
+namespace WebUtils {
+    BandwidthLimiter::BandwidthLimiter(std::size_t bytesPerSecond, double backgroundShare, std::chrono::milliseconds burst) : _rate(bytesPerSecond), _backgroundShare(std::clamp(backgroundShare, 0.0, 1.0)), _burst(burst) {}
+
+    BandwidthLimiter& BandwidthLimiter::Default() {
+        static BandwidthLimiter limiter;
+        return limiter;
+    }
+
+    void BandwidthLimiter::SetRate(std::size_t bytesPerSecond) {
+        std::lock_guard lock(_mutex);
+        Refill(std::chrono::steady_clock::now());
+        _rate = bytesPerSecond;
+    }
+
+    void BandwidthLimiter::Refill(std::chrono::steady_clock::time_point now) {
+        auto elapsed = std::chrono::duration<double>(now - _lastRefill).count();
+        _lastRefill = now;
+
+        double rate = _rate.load(std::memory_order_relaxed);
+        double burstSeconds = std::chrono::duration<double>(_burst).count();
+        _tokens = std::min(_tokens + elapsed * rate, rate * burstSeconds);
+        _backgroundTokens = std::min(_backgroundTokens + elapsed * rate * _backgroundShare, rate * _backgroundShare * burstSeconds);
+    }
+
+    void BandwidthLimiter::Acquire(std::size_t bytes, TrafficClass trafficClass) {
+        // unlimited is the common case, that shouldn't cost a lock per chunk of data
+        if (GetRate() == 0 || bytes == 0) return;
+
+        std::chrono::duration<double> wait{0};
+        while (true) {
+            std::unique_lock lock(_mutex);
+            Refill(std::chrono::steady_clock::now());
+
+            bool throttled = trafficClass == TrafficClass::Background && _activeForeground > 0;
+            // a share of 0 pauses background traffic until the foreground requests are done
+            if (throttled && _backgroundShare <= 0) {
+                lock.unlock();
+                std::this_thread::sleep_for(_burst);
+                continue;
+            }
+
+            // take the bytes right away & wait off the debt after, so a transfer never waits on a bucket that can't fit its chunk
+            double rate = _rate.load(std::memory_order_relaxed);
+            if (rate <= 0) return;
+            _tokens -= bytes;
+            wait = std::chrono::duration<double>(std::max(0.0, -_tokens / rate));
+
+            if (throttled) {
+                _backgroundTokens -= bytes;
+                wait = std::max(wait, std::chrono::duration<double>(-_backgroundTokens / (rate * _backgroundShare)));
+            }
+            break;
+        }
+
+        if (wait.count() > 0) std::this_thread::sleep_for(wait);
+    }
+
+    BandwidthLimiter::ActiveRequest::ActiveRequest(BandwidthLimiter& limiter, TrafficClass trafficClass) noexcept : _limiter(limiter), _trafficClass(trafficClass) {
+        if (_trafficClass == TrafficClass::Foreground) _limiter._activeForeground++;
+    }
+
+    BandwidthLimiter::ActiveRequest::~ActiveRequest() {
+        if (_trafficClass == TrafficClass::Foreground) _limiter._activeForeground--;
+    }
+}
@@ -0,0 +1,257 @@
+#include "Transport.hpp"
+#include "DownloaderUtility.hpp"
+#include "Tracing.hpp"
+#include "logging.hpp"
+
+#include "libcurl/shared/curl.h"
+#include "libcurl/shared/easy.h"
+#include <algorithm>
+#include <array>
+#include <memory>
+
+namespace WebUtils {
+    static std::size_t write_str_cb(char* content, std::size_t size, std::size_t nmemb, std::string* str) {
+        std::string_view addedText(content, (size * nmemb));
+        str->append(addedText);
+        return addedText.size();
+    };
+
+    static int seek_source_cb(IUploadSource* source, curl_off_t offset, int origin) {
+        // curl only seeks back to the start, when it has to resend the body
+        if (offset != 0 || origin != SEEK_SET) return CURL_SEEKFUNC_CANTSEEK;
+        return source->Rewind() ? CURL_SEEKFUNC_OK : CURL_SEEKFUNC_CANTSEEK;
+    };
+
+    /// @brief records the phases curl went through as trace spans, curl reports them as offsets from the start of the transfer
+    static void trace_curl_phases(CURL* curl, Tracing::clock::time_point performStart, uint64_t id) {
+        curl_off_t nameLookup = 0, connect = 0, appConnect = 0, preTransfer = 0, startTransfer = 0, total = 0;
+        curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &nameLookup);
+        curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect);
+        curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &appConnect);
+        curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME_T, &preTransfer);
+        curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &startTransfer);
+        curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total);
+
+        auto phase = [&](char const* name, curl_off_t from, curl_off_t to) {
+            // reused connections skip phases, which curl reports as 0
+            if (to <= from) return;
+            Tracing::RecordSpan(name, "curl", performStart + std::chrono::microseconds(from), performStart + std::chrono::microseconds(to), id);
+        };
+
+        phase("dns", 0, nameLookup);
+        phase("connect", nameLookup, connect);
+        phase("tls", connect, appConnect);
+        phase("wait", std::max(preTransfer, std::max(connect, appConnect)), startTransfer);
+        phase("transfer", startTransfer, total);
+    }
+
+    /// @brief a single attempt of a request, receiving into its own result so concurrent attempts don't mix
+    struct CurlTransfer {
+        CURL* curl = curl_easy_init();
+        IUploadSource* body;
+        BandwidthLimiter* limiter;
+        /// @brief the request this is an attempt of, outlives the transfer
+        TransferRequest const& request;
+        /// @brief the extra headers with the prepared list linked on the end, unlinked again before freeing
+        curl_slist* headers = nullptr;
+        curl_slist* extraHeadersTail = nullptr;
+        TransferResult result;
+        /// @brief only set while tracing, it is just used for the phase spans
+        Tracing::clock::time_point start;
+
+        /// @param reportProgress whether this attempt reports progress, hedged duplicates don't
+        CurlTransfer(TransferRequest const& request, bool reportProgress) : body(request.body), limiter(request.limiter), request(request) {
+            auto& prepared = request.prepared;
+            auto& urlOptions = prepared.options();
+
+            for (auto& header : request.extraHeaders) {
+                headers = curl_slist_append(headers, header.c_str());
+            }
+
+            // link the prepared list on the end of ours instead of copying it
+            extraHeadersTail = headers;
+            while (extraHeadersTail && extraHeadersTail->next) extraHeadersTail = extraHeadersTail->next;
+            if (extraHeadersTail) extraHeadersTail->next = prepared.headerList();
+            else headers = prepared.headerList();
+
+            curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+            curl_easy_setopt(curl, CURLOPT_URL, prepared.escapedURL().c_str());
+            curl_easy_setopt(curl, CURLOPT_TIMEOUT, prepared.timeOut());
+            curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, urlOptions.encoding.c_str());
+            curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+            curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, std::string(request.method).c_str());
+
+            if (request.body) {
+                curl_easy_setopt(curl, CURLOPT_POST, 1L);
+                if (auto bodySize = request.body->Size()) curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)*bodySize);
+                curl_easy_setopt(curl, CURLOPT_READFUNCTION, read_cb);
+                curl_easy_setopt(curl, CURLOPT_READDATA, this);
+                curl_easy_setopt(curl, CURLOPT_SEEKFUNCTION, seek_source_cb);
+                curl_easy_setopt(curl, CURLOPT_SEEKDATA, request.body);
+            }
+
+            if (reportProgress && request.progressReport && *request.progressReport != nullptr) {
+                curl_easy_setopt(curl, CURLOPT_NOPROGRESS, false);
+                curl_easy_setopt(curl, CURLOPT_XFERINFODATA, request.progressReport);
+                if (request.body) {
+                    curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, +[](std::function<void(float)> const* progressReport, curl_off_t dltotal, curl_off_t dlnow, curl_off_t utotal, curl_off_t unow){
+                        // progress for requests with a body is the upload values. chunked uploads have no total, so no progress either
+                        float progress = utotal > 0 ? (float)unow / (float)utotal : 0.0f;
+                        (*progressReport)(progress);
+                        return 0;
+                    });
+                } else {
+                    curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, +[](std::function<void(float)> const* progressReport, curl_off_t dltotal, curl_off_t dlnow, curl_off_t utotal, curl_off_t unow){
+                        // progress for requests without a body is the download values. responses without a length have no total, so no progress either
+                        float progress = dltotal > 0 ? (float)dlnow / (float)dltotal : 0.0f;
+                        (*progressReport)(progress);
+                        return 0;
+                    });
+                }
+            }
+
+            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_cb);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, this);
+
+            curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, write_str_cb);
+            curl_easy_setopt(curl, CURLOPT_HEADERDATA, &result.headers);
+
+            curl_easy_setopt(curl, CURLOPT_USERAGENT, prepared.userAgent().c_str());
+            curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, urlOptions.useSSL ? 1 : 0);
+            curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, urlOptions.useSSL ? 2 : 0);
+
+            if (Tracing::IsEnabled()) start = Tracing::clock::now();
+        }
+
+        ~CurlTransfer() {
+            curl_easy_cleanup(curl);
+            if (extraHeadersTail) {
+                extraHeadersTail->next = nullptr;
+                curl_slist_free_all(headers);
+            }
+        }
+
+        // blocking in these callbacks stalls the transfer, which is how the bandwidth limit gets applied
+        static std::size_t write_cb(uint8_t* content, std::size_t size, std::size_t nmemb, CurlTransfer* transfer) {
+            std::span<uint8_t> addedData(content, (size * nmemb));
+            if (transfer->limiter) transfer->limiter->Acquire(addedData.size(), transfer->request.CurrentTrafficClass());
+            transfer->result.data.insert(transfer->result.data.end(), addedData.begin(), addedData.end());
+            return addedData.size();
+        }
+
+        static std::size_t read_cb(char* buffer, std::size_t size, std::size_t nitems, CurlTransfer* transfer) {
+            auto read = transfer->body->Read(std::span<uint8_t>((uint8_t*)buffer, size * nitems));
+            if (!read.has_value()) return CURL_READFUNC_ABORT;
+            if (transfer->limiter) transfer->limiter->Acquire(*read, transfer->request.CurrentTrafficClass());
+            return *read;
+        }
+
+        CurlTransfer(CurlTransfer const&) = delete;
+        CurlTransfer& operator=(CurlTransfer const&) = delete;
+
+        /// @brief fills in the rest of the result once curl is done with the transfer
+        TransferResult Finish(CURLcode status, uint64_t traceId) {
+            result.curlStatus = status;
+
+            long httpCode = 0;
+            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &httpCode);
+            result.httpCode = httpCode;
+
+            curl_off_t total = 0;
+            curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total);
+            result.latency = std::chrono::microseconds(total);
+
+            if (start != Tracing::clock::time_point{}) trace_curl_phases(curl, start, traceId);
+            return std::move(result);
+        }
+    };
+
+    CurlTransport& CurlTransport::Default() {
+        static CurlTransport transport;
+        return transport;
+    }
+
+    TransferResult CurlTransport::Perform(TransferRequest const& request) {
+        CurlTransfer transfer(request, true);
+        return transfer.Finish(curl_easy_perform(transfer.curl), request.traceId);
+    }
+
+    TransferResult CurlTransport::PerformHedged(TransferRequest const& request, std::chrono::microseconds hedgeDelay) {
+        // a body can only be read by one attempt at a time
+        if (request.body) return Perform(request);
+
+        std::array<std::unique_ptr<CurlTransfer>, 2> transfers;
+        transfers[0] = std::make_unique<CurlTransfer>(request, true);
+
+        auto multi = curl_multi_init();
+        curl_multi_add_handle(multi, transfers[0]->curl);
+
+        auto primaryStart = std::chrono::steady_clock::now();
+        auto hedgeAt = primaryStart + hedgeDelay;
+        std::chrono::steady_clock::time_point hedgeStart;
+        std::size_t running = 1;
+        CurlTransfer* winner = nullptr;
+        CurlTransfer* lastFailed = nullptr;
+        CURLcode winnerStatus = CURLE_OK;
+        CURLcode lastFailedStatus = CURLE_OK;
+
+        // both run on one multi handle, the first to succeed wins & the other is dropped. a failure only wins if nothing else is still running
+        while (!winner) {
+            int stillRunning = 0;
+            if (auto code = curl_multi_perform(multi, &stillRunning); code != CURLM_OK) {
+                ERROR("curl multi failed while hedging: {}", curl_multi_strerror(code));
+                winner = transfers[0].get();
+                winnerStatus = CURLE_FAILED_INIT;
+                break;
+            }
+
+            int queued = 0;
+            while (auto message = curl_multi_info_read(multi, &queued)) {
+                if (message->msg != CURLMSG_DONE) continue;
+
+                auto transfer = message->easy_handle == transfers[0]->curl ? transfers[0].get() : transfers[1].get();
+                running--;
+
+                if (message->data.result == CURLE_OK) {
+                    winner = transfer;
+                    winnerStatus = CURLE_OK;
+                    break;
+                }
+                lastFailed = transfer;
+                lastFailedStatus = message->data.result;
+            }
+
+            if (winner) break;
+            if (running == 0) {
+                winner = lastFailed;
+                winnerStatus = lastFailedStatus;
+                break;
+            }
+
+            // a primary that failed before the hedge point already ended above, so the duplicate only goes out for slow requests
+            auto now = std::chrono::steady_clock::now();
+            if (!transfers[1] && now >= hedgeAt) {
+                Tracing::RecordInstant("hedge", "request", request.traceId);
+                hedgeStart = now;
+                transfers[1] = std::make_unique<CurlTransfer>(request, false);
+                curl_multi_add_handle(multi, transfers[1]->curl);
+                running++;
+                continue;
+            }
+
+            int timeoutMs = 1000;
+            if (!transfers[1]) timeoutMs = std::clamp<int>(std::chrono::ceil<std::chrono::milliseconds>(hedgeAt - now).count(), 0, timeoutMs);
+            curl_multi_poll(multi, nullptr, 0, timeoutMs, nullptr);
+        }
+
+        for (auto& transfer : transfers) {
+            if (transfer) curl_multi_remove_handle(multi, transfer->curl);
+        }
+        curl_multi_cleanup(multi);
+
+        auto result = winner->Finish(winnerStatus, request.traceId);
+        // curl times the hedge from when it went out, the caller waited since the primary went out
+        if (winner == transfers[1].get()) result.latency += std::chrono::duration_cast<std::chrono::microseconds>(hedgeStart - primaryStart);
+        return result;
+    }
+}
@@ -0,0 +1,50 @@
+#include "DeflateReader.hpp"
+
+namespace WebUtils {
+    DeflateReader::DeflateReader(IUploadSource& source, bool gzip, int level) : _source(source) {
+        // 15 is the max window size, +16 makes zlib write a gzip header & trailer instead
+        int windowBits = gzip ? 15 + 16 : 15;
+        _initialized = deflateInit2(&_stream, level, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    }
+
+    DeflateReader::~DeflateReader() {
+        if (_initialized) deflateEnd(&_stream);
+    }
+
+    std::optional<std::size_t> DeflateReader::Read(std::span<uint8_t> buffer) {
+        if (!_initialized) return std::nullopt;
+        if (_finished || buffer.empty()) return 0;
+
+        _stream.next_out = buffer.data();
+        _stream.avail_out = buffer.size();
+
+        // keep going until the buffer is full, returning less than asked is fine but returning 0 would end the upload early
+        while (_stream.avail_out > 0 && !_finished) {
+            if (_stream.avail_in == 0 && !_inputDone) {
+                auto read = _source.Read(_input);
+                if (!read.has_value()) return std::nullopt;
+                _inputDone = *read == 0;
+                _stream.next_in = _input.data();
+                _stream.avail_in = *read;
+            }
+
+            auto result = deflate(&_stream, _inputDone ? Z_FINISH : Z_NO_FLUSH);
+            if (result == Z_STREAM_END) _finished = true;
+            // no progress possible, only an issue if there's no more input coming
+            else if (result == Z_BUF_ERROR && _inputDone) break;
+            else if (result != Z_OK && result != Z_BUF_ERROR) return std::nullopt;
+        }
+
+        return buffer.size() - _stream.avail_out;
+    }
+
+    bool DeflateReader::Rewind() {
+        if (!_initialized || !_source.Rewind()) return false;
+        if (deflateReset(&_stream) != Z_OK) return false;
+
+        _stream.avail_in = 0;
+        _inputDone = false;
+        _finished = false;
+        return true;
+    }
+}
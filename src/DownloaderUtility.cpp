@@ -1,4 +1,7 @@
 #include "DownloaderUtility.hpp"
+#include "DeflateReader.hpp"
+#include "StartupPrefetcher.hpp"
+#include "Tracing.hpp"
 #include "logging.hpp"
 
 #include "libcurl/shared/curl.h"
@@ -6,6 +9,12 @@
 #include <fmt/core.h>
 #include <filesystem>
 #include <fstream>
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <thread>
+#include <utility>
 
 namespace WebUtils {
     std::pair<char, char> getByteChars(char c) {
@@ -61,20 +70,93 @@ namespace WebUtils {
         return {url.c_str(), divider};
     }
 
-    static std::size_t write_vec_cb(uint8_t* content, std::size_t size, std::size_t nmemb, std::vector<uint8_t>* vec) {
-        std::span<uint8_t> addedData(content, (size * nmemb));
-        vec->insert(std::next(vec->begin(), vec->size()), addedData.begin(), addedData.end());
-        return addedData.size();
-    };
+    std::string URLOptions::origin() const {
+        auto divider = url.find("://");
+        if (divider == std::string::npos) return {};
+        auto hostEnd = url.find_first_of("/?#", divider + 3);
+
+        // scheme & host are case insensitive, so differently cased urls end up with the same origin
+        std::string result = url.substr(0, hostEnd);
+        std::transform(result.begin(), result.end(), result.begin(), [](unsigned char c) { return std::tolower(c); });
+        return result;
+    }
 
-    static std::size_t write_str_cb(char* content, std::size_t size, std::size_t nmemb, std::string* str) {
-        std::string_view addedText(content, (size * nmemb));
-        str->append(addedText);
-        return addedText.size();
-    };
+    PreparedRequest::PreparedRequest(URLOptions options, std::string_view defaultUserAgent, int defaultTimeOut) :
+        _options(std::move(options)),
+        _userAgent(_options.userAgent.value_or(std::string(defaultUserAgent))),
+        _timeOut(_options.timeOut.value_or(defaultTimeOut)) {
+        // file urls never go through curl
+        if (_options.isFileURL()) return;
+
+        _escapedURL = _options.fullURl();
+        for (const auto& [key, value] : _options.headers) {
+            _headerList = curl_slist_append(_headerList, fmt::format("{}: {}", key, value).c_str());
+        }
+    }
+
+    PreparedRequest::~PreparedRequest() {
+        curl_slist_free_all(_headerList);
+    }
+
+    PreparedRequest::PreparedRequest(PreparedRequest&& other) noexcept :
+        _options(std::move(other._options)),
+        _escapedURL(std::move(other._escapedURL)),
+        _headerList(std::exchange(other._headerList, nullptr)),
+        _userAgent(std::move(other._userAgent)),
+        _timeOut(other._timeOut) {}
+
+    PreparedRequest& PreparedRequest::operator=(PreparedRequest&& other) noexcept {
+        if (this == &other) return *this;
+
+        curl_slist_free_all(_headerList);
+        _options = std::move(other._options);
+        _escapedURL = std::move(other._escapedURL);
+        _headerList = std::exchange(other._headerList, nullptr);
+        _userAgent = std::move(other._userAgent);
+        _timeOut = other._timeOut;
+        return *this;
+    }
+
+    PreparedRequest DownloaderUtility::Prepare(URLOptions urlOptions) const {
+        return PreparedRequest(std::move(urlOptions), userAgent, timeOut);
+    }
+
+    StartupPrefetcher& DownloaderUtility::Prefetcher() const {
+        return prefetcher ? *prefetcher : StartupPrefetcher::Default();
+    }
 
     bool DownloaderUtility::GetInto(URLOptions urlOptions, IResponse* response, std::function<void(float)> progressReport) const {
         if (!response) return false;
+        return GetInto(Prepare(std::move(urlOptions)), response, std::move(progressReport));
+    }
+
+    /// @brief finds the last Retry-After header given in seconds, the date form is ignored
+    static std::optional<std::chrono::seconds> parse_retry_after(std::string_view headers) {
+        static constexpr std::string_view name = "retry-after:";
+        std::optional<std::chrono::seconds> result;
+
+        while (!headers.empty()) {
+            auto lineEnd = headers.find('\n');
+            auto line = headers.substr(0, lineEnd);
+            headers = lineEnd == std::string_view::npos ? std::string_view() : headers.substr(lineEnd + 1);
+
+            if (line.size() < name.size()) continue;
+            if (!std::equal(name.begin(), name.end(), line.begin(), [](char a, char b) { return a == std::tolower(b); })) continue;
+
+            auto value = line.substr(name.size());
+            while (!value.empty() && value.front() == ' ') value.remove_prefix(1);
+
+            int seconds = 0;
+            auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), seconds);
+            if (ec == std::errc() && seconds >= 0) result = std::chrono::seconds(seconds);
+        }
+
+        return result;
+    }
+
+    bool DownloaderUtility::GetInto(PreparedRequest const& prepared, IResponse* response, std::function<void(float)> progressReport, std::atomic<TrafficClass> const* liveTrafficClass) const {
+        if (!response) return false;
+        auto& urlOptions = prepared.options();
 
         // if the url is for a filepath, read it from disk instead
         if (urlOptions.isFileURL()) {
@@ -93,65 +175,92 @@ namespace WebUtils {
             }
         }
 
-        auto curl = curl_easy_init();
-        struct curl_slist* curl_headers = nullptr;
-        for (const auto& [key, value] : urlOptions.headers) {
-            curl_headers = curl_slist_append(curl_headers, fmt::format("{}: {}", key, value).c_str());
+        auto traceId = Tracing::IdOf(response);
+        // only the latency tracker uses the origin
+        auto origin = hedgePolicy.has_value() ? urlOptions.origin() : std::string();
+        auto trafficClass = liveTrafficClass ? liveTrafficClass->load(std::memory_order_relaxed) : urlOptions.trafficClass.value_or(this->trafficClass);
+        TransferRequest request{.prepared = prepared, .method = "GET", .progressReport = &progressReport, .traceId = traceId, .limiter = &Limiter(), .trafficClass = trafficClass, .liveTrafficClass = liveTrafficClass};
+        TransferResult result;
+
+        // startup requests get recorded for the next launch, & might already be prefetched from the last one.
+        // requests with a live class are left out, those are managed by whatever changes their class (like prefetches themselves),
+        // as are requests going through another transport than the prefetches, a prefetch of the real network can't stand in for those
+        std::optional<TransferResult> prefetched;
+        auto& prefetcher = Prefetcher();
+        if (trafficClass == TrafficClass::Foreground && !liveTrafficClass && &Transport() == &prefetcher.dispatcher.downloader.Transport()) {
+            // counted as foreground while it might wait on a prefetch, so other background traffic makes room like it would for the request itself
+            BandwidthLimiter::ActiveRequest waiting(Limiter(), TrafficClass::Foreground);
+            prefetched = prefetcher.Claim(prepared);
         }
 
-        auto escapedUrl = urlOptions.fullURl();
-
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, curl_headers);
-        curl_easy_setopt(curl, CURLOPT_URL, escapedUrl.c_str());
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, urlOptions.timeOut.value_or(timeOut));
-        curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, urlOptions.encoding.c_str());
-        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "GET");
-
-        if (progressReport != nullptr) {
-            curl_easy_setopt(curl, CURLOPT_NOPROGRESS, false);
-            curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &progressReport);
-            curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, +[](std::function<void(float)>* progressReport, curl_off_t dltotal, curl_off_t dlnow, curl_off_t utotal, curl_off_t unow){
-                auto& func = *progressReport;
-                // progress for get is the download values
-                float progress = (float)dlnow / (float)dltotal;
-                if (std::isnan(progress)) progress = 0.0f;
-                func(progress);
-                return 0;
-            });
-        }
+        if (prefetched.has_value()) {
+            Tracing::RecordInstant("prefetch hit", "request", traceId);
+            result = std::move(*prefetched);
+        } else {
+            for (std::size_t retry = 0;; retry++) {
+                std::optional<std::chrono::microseconds> hedgeDelay;
+                if (hedgePolicy.has_value()) {
+                    if (hedgePolicy->delay.has_value()) hedgeDelay = hedgePolicy->delay;
+                    else hedgeDelay = latencyTracker->Percentile(origin, hedgePolicy->percentile, hedgePolicy->minSamples);
+                    if (hedgeDelay.has_value()) hedgeDelay = std::max<std::chrono::microseconds>(*hedgeDelay, hedgePolicy->minDelay);
+                }
 
-        std::vector<uint8_t> recvData;
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_vec_cb);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &recvData);
+                {
+                    Tracing::ScopedSpan span("GET", "request", traceId);
+                    BandwidthLimiter::ActiveRequest active(Limiter(), trafficClass);
+                    result = hedgeDelay.has_value() ? Transport().PerformHedged(request, *hedgeDelay) : Transport().Perform(request);
+                }
 
-        std::string recvHeaders;
-        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, write_str_cb);
-        curl_easy_setopt(curl, CURLOPT_HEADERDATA, &recvHeaders);
+                if (hedgePolicy.has_value() && result.curlStatus == CURLE_OK) {
+                    latencyTracker->Record(origin, result.latency);
+                }
 
-        std::string userAgent = urlOptions.userAgent.value_or(this->userAgent);
-        curl_easy_setopt(curl, CURLOPT_USERAGENT, userAgent.c_str());
-        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, urlOptions.useSSL ? 1 : 0);
-        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, urlOptions.useSSL ? 2 : 0);
+                if (retry >= retryPolicy.maxRetries || !retryPolicy.ShouldRetry(result.curlStatus, result.httpCode)) break;
 
-        response->CurlStatus = curl_easy_perform(curl);
+                auto delay = retryPolicy.Delay(retry);
+                if (retryPolicy.respectRetryAfter) {
+                    if (auto retryAfter = parse_retry_after(result.headers)) {
+                        delay = std::min<std::chrono::milliseconds>(std::max<std::chrono::milliseconds>(delay, *retryAfter), retryPolicy.maxDelay);
+                    }
+                }
 
-        int httpCode = 0;
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &httpCode);
-        response->HttpCode = httpCode;
+                VERBOSE("Retrying get after curl {}, http {} in {}ms", result.curlStatus, result.httpCode, delay.count());
+                Tracing::ScopedSpan span("backoff", "request", traceId);
+                std::this_thread::sleep_for(delay);
+            }
+        }
+
+        response->CurlStatus = result.curlStatus;
+        response->HttpCode = result.httpCode;
 
-        VERBOSE("Get result: curl {}, http {}", response->CurlStatus, httpCode);
+        VERBOSE("Get result: curl {}, http {}", response->CurlStatus, response->HttpCode);
 
         if (response->CurlStatus == CURLE_OK) {
-            response->AcceptData(recvData);
-            response->AcceptHeaders(recvHeaders);
+            // parsed on the calling thread, responses like textures & sprites wait on the main thread while parsing
+            Tracing::ScopedSpan parseSpan("parse", "response", traceId);
+            response->AcceptData(result.data);
+            response->AcceptHeaders(result.headers);
         }
 
-        curl_easy_cleanup(curl);
         return response->IsSuccessful() && response->DataParsedSuccessful();
     }
 
     bool DownloaderUtility::PostInto(URLOptions urlOptions, std::span<uint8_t const> data, IResponse* response, std::function<void(float)> progressReport) const {
+        SpanUploadSource source(data);
+        return PostInto(Prepare(std::move(urlOptions)), source, response, std::move(progressReport));
+    }
+
+    bool DownloaderUtility::PostInto(URLOptions urlOptions, IUploadSource& source, IResponse* response, std::function<void(float)> progressReport) const {
+        return PostInto(Prepare(std::move(urlOptions)), source, response, std::move(progressReport));
+    }
+
+    bool DownloaderUtility::PostInto(PreparedRequest const& prepared, std::span<uint8_t const> data, IResponse* response, std::function<void(float)> progressReport) const {
+        SpanUploadSource source(data);
+        return PostInto(prepared, source, response, std::move(progressReport));
+    }
+
+    bool DownloaderUtility::PostInto(PreparedRequest const& prepared, IUploadSource& source, IResponse* response, std::function<void(float)> progressReport) const {
+        auto& urlOptions = prepared.options();
         // if the url is for a filepath, write it to disk instead
         if (urlOptions.isFileURL()) {
             std::filesystem::path filePath(urlOptions.url.substr(7));
@@ -163,9 +272,19 @@ namespace WebUtils {
                     std::filesystem::remove(filePath);
                 }
 
-                // write out
+                // write out in chunks, the source might not fit in memory
                 std::ofstream file(filePath, std::ios::binary | std::ios::out);
-                file.write((char*)data.data(), data.size());
+                std::array<uint8_t, 16 * 1024> buffer;
+                std::optional<std::size_t> read;
+                while ((read = source.Read(buffer)).value_or(0) > 0) {
+                    file.write((char*)buffer.data(), *read);
+                }
+
+                // source errored
+                if (!read.has_value()) {
+                    if (response) response->CurlStatus = CURLE_READ_ERROR;
+                    return false;
+                }
 
                 // response will just get 0 length return
                 if (response) {
@@ -180,70 +299,60 @@ namespace WebUtils {
             }
         }
 
-        auto curl = curl_easy_init();
-        struct curl_slist* curl_headers = nullptr;
-        for (const auto& [key, value] : urlOptions.headers) {
-            curl_headers = curl_slist_append(curl_headers, fmt::format("{}: {}", key, value).c_str());
+        // compressed bodies get deflated in chunks while they are sent, so the compressed data is never fully in memory
+        std::optional<DeflateReader> compressor;
+        if (urlOptions.bodyCompression != BodyCompression::None) {
+            compressor.emplace(source, urlOptions.bodyCompression == BodyCompression::Gzip, WEBUTILS_COMPRESSION_LEVEL);
+            if (!compressor->valid()) {
+                WARN("Failed to initialize body compression, sending uncompressed");
+                compressor.reset();
+            }
         }
+        IUploadSource& body = compressor.has_value() ? *compressor : source;
 
-        auto escapedUrl = urlOptions.fullURl();
-
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, curl_headers);
-        curl_easy_setopt(curl, CURLOPT_URL, escapedUrl.c_str());
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, urlOptions.timeOut.value_or(timeOut));
-        curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, urlOptions.encoding.c_str());
-        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "POST");
-
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, data.size());
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, (char*)data.data());
-
-        if (progressReport != nullptr) {
-            curl_easy_setopt(curl, CURLOPT_NOPROGRESS, false);
-            curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &progressReport);
-            curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, +[](std::function<void(float)>* progressReport, curl_off_t dltotal, curl_off_t dlnow, curl_off_t utotal, curl_off_t unow){
-                auto& func = *progressReport;
-                // progress for post is the upload values
-                float progress = (float)unow/ (float)utotal;
-                if (std::isnan(progress)) progress = 0.0f;
-                func(progress);
-                return 0;
-            });
-        }
+        // headers that depend on the body, sent on top of the prepared ones
+        std::vector<std::string> bodyHeaders;
 
-        std::vector<uint8_t> recvData;
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_vec_cb);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &recvData);
+        if (auto contentType = body.ContentType(); contentType.has_value() && !urlOptions.headers.contains("Content-Type")) {
+            bodyHeaders.emplace_back(fmt::format("Content-Type: {}", *contentType));
+        }
 
-        std::string recvHeaders;
-        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, write_str_cb);
-        curl_easy_setopt(curl, CURLOPT_HEADERDATA, &recvHeaders);
+        if (compressor.has_value()) {
+            auto encoding = urlOptions.bodyCompression == BodyCompression::Gzip ? "gzip" : "deflate";
+            bodyHeaders.emplace_back(fmt::format("Content-Encoding: {}", encoding));
+        }
 
-        std::string userAgent = urlOptions.userAgent.value_or(this->userAgent);
-        curl_easy_setopt(curl, CURLOPT_USERAGENT, userAgent.c_str());
-        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, urlOptions.useSSL ? 1 : 0);
-        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, urlOptions.useSSL ? 2 : 0);
+        // without a known size the body is sent chunked
+        if (!body.Size().has_value()) {
+            bodyHeaders.emplace_back("Transfer-Encoding: chunked");
+        }
 
-        int curlStatus = curl_easy_perform(curl);
+        auto traceId = Tracing::IdOf(response ? (void const*)response : (void const*)&source);
+        auto trafficClass = urlOptions.trafficClass.value_or(this->trafficClass);
+        TransferRequest request{.prepared = prepared, .method = "POST", .extraHeaders = bodyHeaders, .body = &body, .progressReport = &progressReport, .traceId = traceId, .limiter = &Limiter(), .trafficClass = trafficClass};
 
-        int httpCode = 0;
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &httpCode);
+        TransferResult result;
+        {
+            Tracing::ScopedSpan span("POST", "request", traceId);
+            BandwidthLimiter::ActiveRequest active(Limiter(), trafficClass);
+            result = Transport().Perform(request);
+        }
 
-        VERBOSE("Post result: curl {}, http {}", curlStatus, httpCode);
+        VERBOSE("Post result: curl {}, http {}", result.curlStatus, result.httpCode);
         if (response) {
-            response->CurlStatus = curlStatus;
-            response->HttpCode = httpCode;
+            response->CurlStatus = result.curlStatus;
+            response->HttpCode = result.httpCode;
 
             if (response->CurlStatus == CURLE_OK) {
-                response->AcceptData(recvData);
-                response->AcceptHeaders(recvHeaders);
+                // parsed on the calling thread, like GetInto does
+                Tracing::ScopedSpan parseSpan("parse", "response", traceId);
+                response->AcceptData(result.data);
+                response->AcceptHeaders(result.headers);
             }
 
-            curl_easy_cleanup(curl);
             return response->IsSuccessful() && response->DataParsedSuccessful();
         }
 
-        curl_easy_cleanup(curl);
-        return curlStatus == CURLE_OK;
+        return result.curlStatus == CURLE_OK;
     }
 }
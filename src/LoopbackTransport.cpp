@@ -0,0 +1,229 @@
+#include "LoopbackTransport.hpp"
+#include "Tracing.hpp"
+
+#include <fmt/core.h>
+#include <algorithm>
+#include <array>
+#include <exception>
+#include <thread>
+
+namespace WebUtils {
+    // curl codes the loopback reports, same as curl would for these cases
+    static constexpr int LOOPBACK_ABORTED_BY_CALLBACK = 42;
+    static constexpr int LOOPBACK_OPERATION_TIMEDOUT = 28;
+
+    LoopbackTransport::LoopbackTransport(LoopbackConditions conditions, uint32_t seed) : _conditions(conditions), _random(seed) {}
+
+    void LoopbackTransport::Serve(std::string urlPrefix, Handler handler) {
+        std::lock_guard lock(_mutex);
+        _routes.emplace_back(std::move(urlPrefix), std::move(handler));
+    }
+
+    void LoopbackTransport::Serve(std::string urlPrefix, LoopbackResponse response) {
+        Serve(std::move(urlPrefix), [response = std::move(response)](LoopbackRequest const&) { return response; });
+    }
+
+    void LoopbackTransport::SetConditions(LoopbackConditions conditions) {
+        std::lock_guard lock(_mutex);
+        _conditions = conditions;
+    }
+
+    /// @brief reads a whole upload source, handlers get the body in one piece
+    static std::optional<std::vector<uint8_t>> read_body(IUploadSource& source) {
+        std::vector<uint8_t> body;
+        if (auto size = source.Size()) body.reserve(*size);
+
+        std::array<uint8_t, 16 * 1024> buffer;
+        std::optional<std::size_t> read;
+        while ((read = source.Read(buffer)).value_or(0) > 0) {
+            body.insert(body.end(), buffer.begin(), buffer.begin() + *read);
+        }
+
+        if (!read.has_value()) return std::nullopt;
+        return body;
+    }
+
+    /// @brief formats headers the way curl hands them over, status line included
+    static std::string format_headers(int httpCode, URLOptions::HeaderMap const& headers) {
+        auto formatted = fmt::format("HTTP/1.1 {}\r\n", httpCode);
+        for (auto& [name, value] : headers) formatted += fmt::format("{}: {}\r\n", name, value);
+        formatted += "\r\n";
+        return formatted;
+    }
+
+    /// @brief time an attempt takes from start to end, cut off at the request timeout
+    static std::chrono::microseconds attempt_duration(TransferRequest const& request, std::chrono::microseconds total) {
+        // timeout 0 means none, like with curl
+        auto timeOut = request.prepared.timeOut();
+        if (timeOut <= 0) return total;
+        return std::min<std::chrono::microseconds>(total, std::chrono::seconds(timeOut));
+    }
+
+    LoopbackTransport::Attempt LoopbackTransport::Simulate(TransferRequest const& request, std::vector<uint8_t> const& body) {
+        auto& url = request.prepared.escapedURL();
+
+        LoopbackConditions conditions;
+        Handler handler;
+        bool failed, httpFailed;
+        std::chrono::microseconds jitter{0};
+        {
+            std::lock_guard lock(_mutex);
+            conditions = _conditions;
+
+            std::size_t matchLength = 0;
+            for (auto& [prefix, routeHandler] : _routes) {
+                if (url.starts_with(prefix) && (!handler || prefix.size() > matchLength)) {
+                    handler = routeHandler;
+                    matchLength = prefix.size();
+                }
+            }
+
+            std::uniform_real_distribution<double> chance(0.0, 1.0);
+            failed = chance(_random) < conditions.errorRate;
+            httpFailed = chance(_random) < conditions.httpErrorRate;
+            if (conditions.jitter.count() > 0) {
+                jitter = std::chrono::microseconds(std::uniform_int_distribution<int64_t>(0, conditions.jitter.count())(_random));
+            }
+        }
+
+        Attempt attempt{ .latency = conditions.latency + jitter, .transfer = std::chrono::microseconds(0) };
+        if (failed) {
+            attempt.result.curlStatus = conditions.errorCode;
+            return attempt;
+        }
+
+        _requestCount++;
+        LoopbackResponse response;
+        if (httpFailed) {
+            response.httpCode = conditions.httpErrorCode;
+        } else if (!handler) {
+            response = LoopbackResponse::Text("no loopback route for url", 404);
+        } else {
+            LoopbackRequest loopbackRequest{ .method = request.method, .url = url, .headers = request.prepared.options().headers, .body = body };
+            for (std::string_view header : request.extraHeaders) {
+                auto separator = header.find(':');
+                if (separator == std::string_view::npos) continue;
+                auto value = header.substr(separator + 1);
+                while (!value.empty() && value.front() == ' ') value.remove_prefix(1);
+                loopbackRequest.headers[std::string(header.substr(0, separator))] = value;
+            }
+
+            try {
+                response = handler(loopbackRequest);
+            } catch (std::exception const& e) {
+                response = LoopbackResponse::Text(e.what(), 500);
+            }
+        }
+
+        attempt.result.httpCode = response.httpCode;
+        attempt.result.headers = format_headers(response.httpCode, response.headers);
+        attempt.result.data = std::move(response.data);
+
+        if (conditions.bandwidth > 0) {
+            auto bytes = body.size() + attempt.result.data.size();
+            attempt.transfer = std::chrono::microseconds(bytes * 1'000'000 / conditions.bandwidth);
+        }
+
+        return attempt;
+    }
+
+    void LoopbackTransport::Wait(TransferRequest const& request, Attempt& attempt, std::size_t bodySize, bool reportProgress) const {
+        auto start = std::chrono::steady_clock::now();
+        auto total = attempt.latency + attempt.transfer;
+        auto duration = attempt_duration(request, total);
+
+        auto timedOut = [&]() {
+            attempt.result = TransferResult{ .curlStatus = LOOPBACK_OPERATION_TIMEDOUT, .latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start) };
+        };
+
+        if (duration < total) {
+            std::this_thread::sleep_for(duration);
+            return timedOut();
+        }
+
+        std::this_thread::sleep_for(attempt.latency);
+
+        // the data "transfers" in chunks like it would over a socket, so progress & the bandwidth limiter work the same as with curl
+        auto bytes = attempt.result.curlStatus == 0 ? bodySize + attempt.result.data.size() : 0;
+        if (bytes == 0) {
+            std::this_thread::sleep_for(attempt.transfer);
+        } else {
+            static constexpr std::size_t chunkSize = 16 * 1024;
+            auto deadline = start + std::chrono::seconds(request.prepared.timeOut());
+            auto& progressReport = request.progressReport;
+            bool reports = reportProgress && progressReport && *progressReport != nullptr;
+
+            for (std::size_t done = 0; done < bytes;) {
+                auto chunk = std::min(chunkSize, bytes - done);
+                std::this_thread::sleep_for(attempt.transfer * chunk / bytes);
+                if (request.limiter) request.limiter->Acquire(chunk, request.CurrentTrafficClass());
+                done += chunk;
+
+                if (request.prepared.timeOut() > 0 && std::chrono::steady_clock::now() > deadline) return timedOut();
+                // upload progress for requests with a body, download progress otherwise. an empty body has no progress, same as curl without an upload total
+                if (reports) {
+                    float progress;
+                    if (request.body) progress = bodySize > 0 ? std::min(done, bodySize) / (float)bodySize : 0.0f;
+                    else progress = (done - std::min(done, bodySize)) / (float)(bytes - bodySize);
+                    (*progressReport)(progress);
+                }
+            }
+        }
+
+        attempt.result.latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    }
+
+    TransferResult LoopbackTransport::Perform(TransferRequest const& request) {
+        std::vector<uint8_t> body;
+        if (request.body) {
+            auto read = read_body(*request.body);
+            if (!read.has_value()) return TransferResult{ .curlStatus = LOOPBACK_ABORTED_BY_CALLBACK };
+            body = std::move(*read);
+        }
+
+        auto attempt = Simulate(request, body);
+        Wait(request, attempt, body.size(), true);
+        return std::move(attempt.result);
+    }
+
+    TransferResult LoopbackTransport::PerformHedged(TransferRequest const& request, std::chrono::microseconds hedgeDelay) {
+        // a body can only be read by one attempt at a time
+        if (request.body) return Perform(request);
+
+        auto primary = Simulate(request, {});
+        auto primaryDuration = attempt_duration(request, primary.latency + primary.transfer);
+        if (primaryDuration <= hedgeDelay) {
+            Wait(request, primary, 0, true);
+            return std::move(primary.result);
+        }
+
+        Tracing::RecordInstant("hedge", "request", request.traceId);
+        auto hedge = Simulate(request, {});
+        auto hedgeDone = hedgeDelay + attempt_duration(request, hedge.latency + hedge.transfer);
+
+        auto succeeds = [&](Attempt const& attempt) {
+            auto total = attempt.latency + attempt.transfer;
+            return attempt.result.curlStatus == 0 && attempt_duration(request, total) == total;
+        };
+
+        // same rules as with curl: the first success wins, if both fail the one finishing last is used since nothing else is running by then
+        bool primarySucceeds = succeeds(primary), hedgeSucceeds = succeeds(hedge);
+        bool useHedge;
+        if (primarySucceeds && hedgeSucceeds) useHedge = hedgeDone < primaryDuration;
+        else if (primarySucceeds != hedgeSucceeds) useHedge = hedgeSucceeds;
+        else useHedge = hedgeDone > primaryDuration;
+
+        if (!useHedge) {
+            Wait(request, primary, 0, true);
+            return std::move(primary.result);
+        }
+
+        auto primaryStart = std::chrono::steady_clock::now();
+        std::this_thread::sleep_for(hedgeDelay);
+        auto hedgeStart = std::chrono::steady_clock::now();
+        Wait(request, hedge, 0, false);
+        // the caller waited since the primary went out, not just for the hedge
+        hedge.result.latency += std::chrono::duration_cast<std::chrono::microseconds>(hedgeStart - primaryStart);
+        return std::move(hedge.result);
+    }
+}
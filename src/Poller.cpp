@@ -0,0 +1,200 @@
+#include "Poller.hpp"
+#include "RawResponse.hpp"
+#include "logging.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <exception>
+#include <optional>
+#include <random>
+
+namespace WebUtils {
+    struct Poller::PollState {
+        PollState(PollId id, URLOptions urlOptions, PollOptions options, ChangeHandler onChanged, PreparedRequest prepared) : id(id), urlOptions(std::move(urlOptions)), options(options), onChanged(std::move(onChanged)), prepared(std::move(prepared)) {}
+
+        PollId id;
+        URLOptions urlOptions;
+        PollOptions options;
+        ChangeHandler onChanged;
+        /// @brief prepared once & only prepared again when the validators change
+        PreparedRequest prepared;
+        std::string etag;
+        std::string lastModified;
+        /// @brief hash of the last content, catches changes for servers without validators or ones ignoring them
+        std::optional<std::size_t> contentHash;
+        std::atomic<bool> cancelled = false;
+    };
+
+    /// @brief finds the value of a header, the last one wins so the final response of a redirect is used
+    static std::string_view find_header(std::string_view headers, std::string_view name) {
+        std::string_view result;
+
+        while (!headers.empty()) {
+            auto lineEnd = headers.find('\n');
+            auto line = headers.substr(0, lineEnd);
+            headers = lineEnd == std::string_view::npos ? std::string_view() : headers.substr(lineEnd + 1);
+
+            if (line.size() <= name.size() || line[name.size()] != ':') continue;
+            if (!std::equal(name.begin(), name.end(), line.begin(), [](char a, char b) { return a == std::tolower(b); })) continue;
+
+            auto value = line.substr(name.size() + 1);
+            while (!value.empty() && value.front() == ' ') value.remove_prefix(1);
+            while (!value.empty() && (value.back() == '\r' || value.back() == ' ')) value.remove_suffix(1);
+            result = value;
+        }
+
+        return result;
+    }
+
+    /// @brief random point in [from, to)
+    static std::chrono::milliseconds random_delay(double from, double to) {
+        if (to <= from) return std::chrono::milliseconds((int64_t)from);
+
+        static thread_local std::mt19937 gen(std::random_device{}());
+        std::uniform_real_distribution<double> dist(from, to);
+        return std::chrono::milliseconds((int64_t)dist(gen));
+    }
+
+    Poller::Poller(std::chrono::milliseconds tick) : _tick(std::max<std::chrono::milliseconds>(tick, std::chrono::milliseconds(1))), _wheel(WEBUTILS_POLL_WHEEL_SLOTS) {}
+
+    Poller::~Poller() {
+        std::unique_lock lock(_mutex);
+        _stopping = true;
+        // polls that were handed to the thread pool but didn't start yet are skipped
+        for (auto& [id, poll] : _polls) poll->cancelled = true;
+        _changed.notify_all();
+        _changed.wait(lock, [this]() { return _inFlight == 0; });
+        lock.unlock();
+
+        if (_timer.joinable()) _timer.join();
+    }
+
+    void Poller::StartTimer() {
+        _start = std::chrono::steady_clock::now();
+        _timer = std::thread(&Poller::TimerThread, this);
+    }
+
+    Poller::PollId Poller::Poll(URLOptions urlOptions, PollOptions options, ChangeHandler onChanged) {
+        if (!onChanged) return 0;
+        std::call_once(_started, &Poller::StartTimer, this);
+
+        auto prepared = downloader.Prepare(urlOptions);
+
+        // spreading the first polls over the interval keeps a batch of polls started together from hitting the server together
+        double interval = options.interval.count();
+        auto firstDelay = options.immediate ? std::chrono::milliseconds(0) : random_delay(0, interval);
+
+        std::lock_guard lock(_mutex);
+        auto poll = std::make_shared<PollState>(_nextId++, std::move(urlOptions), options, std::move(onChanged), std::move(prepared));
+        _polls.emplace(poll->id, poll);
+        Schedule(poll->id, firstDelay);
+        return poll->id;
+    }
+
+    bool Poller::Cancel(PollId id) {
+        std::lock_guard lock(_mutex);
+        auto itr = _polls.find(id);
+        if (itr == _polls.end()) return false;
+
+        // the wheel entry stays, it gets dropped once it's due & the poll isn't there anymore
+        itr->second->cancelled = true;
+        _polls.erase(itr);
+        return true;
+    }
+
+    std::size_t Poller::PollCount() {
+        std::lock_guard lock(_mutex);
+        return _polls.size();
+    }
+
+    void Poller::Schedule(PollId id, std::chrono::milliseconds delay) {
+        // at least a tick out, the current slot was already handled
+        auto ticks = std::max<uint64_t>(1, (delay + _tick - std::chrono::milliseconds(1)) / _tick);
+        auto dueTick = _currentTick + ticks;
+        _wheel[dueTick % _wheel.size()].push_back({ .id = id, .dueTick = dueTick });
+    }
+
+    void Poller::TimerThread() {
+        std::vector<std::shared_ptr<PollState>> due;
+        std::unique_lock lock(_mutex);
+
+        while (!_stopping) {
+            if (_changed.wait_until(lock, _start + _tick * (_currentTick + 1), [this]() { return _stopping; })) break;
+
+            // a late wakeup does every tick it missed, so nothing due in them gets skipped
+            auto now = std::chrono::steady_clock::now();
+            while (_start + _tick * (_currentTick + 1) <= now) {
+                _currentTick++;
+                auto& slot = _wheel[_currentTick % _wheel.size()];
+
+                for (std::size_t i = 0; i < slot.size();) {
+                    if (slot[i].dueTick > _currentTick) {
+                        i++;
+                        continue;
+                    }
+
+                    auto itr = _polls.find(slot[i].id);
+                    if (itr != _polls.end()) due.emplace_back(itr->second);
+                    slot[i] = slot.back();
+                    slot.pop_back();
+                }
+            }
+
+            if (due.empty()) continue;
+            _inFlight += due.size();
+            lock.unlock();
+
+            for (auto& poll : due) {
+                downloader.Pool().Enqueue([this, poll = std::move(poll)]() mutable { RunPoll(std::move(poll)); });
+            }
+            due.clear();
+
+            lock.lock();
+        }
+    }
+
+    void Poller::RunPoll(std::shared_ptr<PollState> poll) {
+        RawResponse response;
+        if (!poll->cancelled) downloader.GetInto(poll->prepared, &response);
+        auto& result = response.result;
+
+        // 304 means the content is the same as for the validators that were sent
+        if (result.curlStatus == 0 && result.httpCode != 304 && response.IsSuccessful()) {
+            auto etag = find_header(result.headers, "etag");
+            auto lastModified = find_header(result.headers, "last-modified");
+            if (etag != poll->etag || lastModified != poll->lastModified) {
+                poll->etag = etag;
+                poll->lastModified = lastModified;
+
+                auto conditional = poll->urlOptions;
+                if (!poll->etag.empty()) conditional.headers["If-None-Match"] = poll->etag;
+                if (!poll->lastModified.empty()) conditional.headers["If-Modified-Since"] = poll->lastModified;
+                poll->prepared = downloader.Prepare(std::move(conditional));
+            }
+
+            auto contentHash = std::hash<std::string_view>{}(std::string_view((char const*)result.data.data(), result.data.size()));
+            if (poll->contentHash != contentHash && !poll->cancelled) {
+                poll->contentHash = contentHash;
+                try {
+                    poll->onChanged(result);
+                } catch (std::exception const& e) {
+                    ERROR("Poll consumer for {} threw: {}", poll->urlOptions.url, e.what());
+                } catch (...) {
+                    ERROR("Poll consumer for {} threw something that is not an exception", poll->urlOptions.url);
+                }
+            }
+        } else if (result.httpCode != 304 && !poll->cancelled) {
+            VERBOSE("Poll of {} failed: curl {}, http {}", poll->urlOptions.url, result.curlStatus, result.httpCode);
+        }
+
+        double interval = poll->options.interval.count();
+        double jitter = interval * std::clamp(poll->options.jitter, 0.0, 1.0);
+        auto delay = random_delay(interval - jitter, interval + jitter);
+
+        std::lock_guard lock(_mutex);
+        if (!poll->cancelled && !_stopping) Schedule(poll->id, delay);
+        _inFlight--;
+        _changed.notify_all();
+    }
+}
@@ -1,26 +1,126 @@
 #include "RatelimitedDispatcher.hpp"
+#include "Tracing.hpp"
+
+#include <algorithm>
+#include <stdexcept>
 
 namespace WebUtils {
+    /// @brief trace id of a request, the response is only looked up while tracing since that's a virtual call
+    static uint64_t trace_id(IRequest const& req) {
+        return Tracing::IsEnabled() ? Tracing::IdOf(req.TargetResponse) : 0;
+    }
+
     bool RatelimitedDispatcher::AnyRequestsToDispatch() {
         std::shared_lock lock(_requestsMutex);
-        return !_requestsToDispatch.empty();
+        return _queuedCount > 0;
     }
 
     std::size_t RatelimitedDispatcher::RequestCountToDispatch() {
         std::shared_lock lock(_requestsMutex);
-        return _requestsToDispatch.size();
+        return _queuedCount;
     }
 
     void RatelimitedDispatcher::AddRequest(std::unique_ptr<IRequest> req) {
+        Tracing::RecordInstant("enqueue", "dispatcher", trace_id(*req));
+        auto origin = req->URL.origin();
+
         std::unique_lock lock(_requestsMutex);
-        _requestsToDispatch.emplace(std::move(req));
+        auto [itr, added] = _hosts.try_emplace(origin);
+        if (added) _hostOrder.emplace_back(std::move(origin));
+        itr->second.requests.emplace(std::move(req));
+        _queuedCount++;
+        lock.unlock();
+
+        _scheduleChanged.notify_one();
     }
 
     std::unique_ptr<IRequest> RatelimitedDispatcher::PopRequest() {
         std::unique_lock lock(_requestsMutex);
-        auto req = std::move(_requestsToDispatch.front());
-        _requestsToDispatch.pop();
-        return std::move(req);
+        // ignores host policies, just takes from the next host that has anything queued
+        for (std::size_t i = 0; i < _hostOrder.size(); i++) {
+            auto& host = _hosts[_hostOrder[(_nextHost + i) % _hostOrder.size()]];
+            if (host.requests.empty()) continue;
+
+            _nextHost = (_nextHost + i + 1) % _hostOrder.size();
+            auto req = std::move(host.requests.front());
+            host.requests.pop();
+            _queuedCount--;
+            return req;
+        }
+        throw std::out_of_range("Tried popping a request while no requests were queued");
+    }
+
+    RatelimitedDispatcher::HostPolicy const* RatelimitedDispatcher::PolicyFor(std::string const& origin) const {
+        auto itr = hostPolicies.find(origin);
+        return itr != hostPolicies.end() ? &itr->second : nullptr;
+    }
+
+    std::optional<RatelimitedDispatcher::ScheduledRequest> RatelimitedDispatcher::ScheduleNext() {
+        std::unique_lock lock(_requestsMutex);
+        while (_queuedCount > 0) {
+            auto now = std::chrono::steady_clock::now();
+            auto earliest = std::chrono::steady_clock::time_point::max();
+            // a slot that's free & past its rate limit, keeping track of when the first rate limited one frees up
+            auto freeSlot = [&](std::span<Slot const> slots) -> std::optional<std::size_t> {
+                for (std::size_t slot = 0; slot < slots.size(); slot++) {
+                    if (slots[slot].busy) continue;
+                    if (slots[slot].freeAt > now) {
+                        earliest = std::min(earliest, slots[slot].freeAt);
+                        continue;
+                    }
+                    return slot;
+                }
+                return std::nullopt;
+            };
+
+            // slots only ever grow, running requests keep their slot index
+            auto slotCount = std::max<std::size_t>(1, maxConcurrentRequests);
+            if (_slots.size() < slotCount) _slots.resize(slotCount);
+            auto slot = freeSlot(std::span<Slot const>(_slots).first(slotCount));
+
+            // round robin over the hosts, starting after the host that was scheduled last
+            for (std::size_t i = 0; slot.has_value() && i < _hostOrder.size(); i++) {
+                auto& origin = _hostOrder[(_nextHost + i) % _hostOrder.size()];
+                auto& host = _hosts[origin];
+                if (host.requests.empty()) continue;
+
+                std::optional<std::size_t> hostSlot;
+                auto policy = PolicyFor(origin);
+                if (policy) {
+                    auto hostSlotCount = std::max<std::size_t>(1, policy->maxConcurrentRequests);
+                    if (host.slots.size() < hostSlotCount) host.slots.resize(hostSlotCount);
+                    hostSlot = freeSlot(std::span<Slot const>(host.slots).first(hostSlotCount));
+                    if (!hostSlot.has_value()) continue;
+
+                    host.slots[*hostSlot].busy = true;
+                    host.slots[*hostSlot].freeAt = now + policy->rateLimitTime;
+                }
+
+                _slots[*slot].busy = true;
+                _slots[*slot].freeAt = now + rateLimitTime;
+                _nextHost = (_nextHost + i + 1) % _hostOrder.size();
+
+                auto req = std::move(host.requests.front());
+                host.requests.pop();
+                _queuedCount--;
+                return ScheduledRequest{ std::move(req), &host, *slot, hostSlot };
+            }
+
+            // nothing can run right now, wait for a rate limit to pass or for a slot to be released
+            Tracing::ScopedSpan span("schedule wait", "dispatcher");
+            if (earliest == std::chrono::steady_clock::time_point::max()) _scheduleChanged.wait(lock);
+            else _scheduleChanged.wait_until(lock, earliest);
+        }
+        return std::nullopt;
+    }
+
+    void RatelimitedDispatcher::ReleaseSlot(ScheduledRequest const& scheduled) {
+        std::unique_lock lock(_requestsMutex);
+        _slots[scheduled.slot].busy = false;
+        if (scheduled.hostSlot.has_value()) scheduled.host->slots[*scheduled.hostSlot].busy = false;
+        lock.unlock();
+
+        _scheduleChanged.notify_all();
     }
 
     std::shared_future<void> RatelimitedDispatcher::StartDispatchIfNeeded() {
@@ -32,23 +132,39 @@ namespace WebUtils {
     }
 
     std::optional<RatelimitedDispatcher::RetryOptions> RatelimitedDispatcher::RequestFinished(bool success, IRequest* req) const {
+        Tracing::ScopedSpan span("onRequestFinished", "callback", trace_id(*req));
         if (onRequestFinished)
             return std::invoke(onRequestFinished, success, req);
         return std::nullopt;
     }
 
     void RatelimitedDispatcher::AllFinished(std::span<std::unique_ptr<IRequest> const> finishedRequests) {
+        Tracing::ScopedSpan span("allFinished", "callback");
         if (allFinished) std::invoke(allFinished, finishedRequests);
     }
 
+    void RatelimitedDispatcher::RequestCompleted(std::unique_ptr<IRequest> req) {
+        Tracing::ScopedSpan span("onRequestCompleted", "callback", trace_id(*req));
+        if (onRequestCompleted) std::invoke(onRequestCompleted, std::move(req));
+    }
+
+    void RatelimitedDispatcher::AllFinishedSummary(DispatchSummary const& summary) {
+        if (allFinishedSummary) std::invoke(allFinishedSummary, summary);
+    }
+
     void RatelimitedDispatcher::DispatcherThread() {
+        auto dispatchStart = std::chrono::steady_clock::now();
+        _requestCount = 0;
+        _failedCount = 0;
+        _retryCount = 0;
+
         while (AnyRequestsToDispatch()) {
             std::vector<std::future<void>> workers;
             // min of define max and field max,
             // max between that and 1 (so we get at least 1),
             // min of that and the amount of reqs we currently have
-            int workerCount = std::min<std::size_t>(RequestCountToDispatch(), std::max<std::size_t>(1, std::min(maxConcurrentRequests, WEBUTILS_MAX_CONCURRENCY)));
-            for (auto i = 0; i < workerCount; i++) {
+            auto workerCount = std::min<std::size_t>(RequestCountToDispatch(), std::max<std::size_t>(1, std::min(maxConcurrentRequests, WEBUTILS_MAX_CONCURRENCY)));
+            for (std::size_t i = 0; i < workerCount; i++) {
                 workers.emplace_back(
                     std::async(std::launch::async, &RatelimitedDispatcher::DispatchWorker, this)
                 );
@@ -59,6 +175,23 @@ namespace WebUtils {
                 d.wait();
             }
         }
+        // taken before the callbacks run, so slow consumers don't count as dispatch time
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - dispatchStart);
+
+        // forget hosts that have nothing queued anymore, so long running dispatchers don't collect every host they ever saw.
+        // hosts still within their rate limit are kept, a dispatch started right after must wait it out too
+        std::unique_lock hostsLock(_requestsMutex);
+        auto now = std::chrono::steady_clock::now();
+        std::erase_if(_hostOrder, [this, now](std::string const& origin) {
+            auto itr = _hosts.find(origin);
+            if (!itr->second.requests.empty()) return false;
+            auto& slots = itr->second.slots;
+            if (std::any_of(slots.begin(), slots.end(), [now](Slot const& slot) { return slot.freeAt > now; })) return false;
+            _hosts.erase(itr);
+            return true;
+        });
+        _nextHost = 0;
+        hostsLock.unlock();
 
         std::unique_lock shared_lock(_finishedMutex);
         AllFinished(_finishedRequests);
@@ -66,32 +199,57 @@ namespace WebUtils {
 
         std::unique_lock lock(_finishedMutex);
         _finishedRequests.clear();
+        lock.unlock();
+
+        AllFinishedSummary({
+            .requestCount = _requestCount,
+            .failedCount = _failedCount,
+            .retryCount = _retryCount,
+            .duration = duration
+        });
     }
 
     void RatelimitedDispatcher::DispatchWorker() {
         // work through backlog
-        while (AnyRequestsToDispatch()) {
-            // after req complete, wait until the rate limit time has passed
-            auto nextRatelimitedRequestTime = std::chrono::high_resolution_clock::now() + rateLimitTime;
-
-            // get req from queue
-            auto req = PopRequest();
-
-            // retry options used if response was ratelimited or something
-            std::optional<RetryOptions> retryOptions;
-            do {
-                if (retryOptions.has_value()) std::this_thread::sleep_for(retryOptions->waitTime);
-
-                bool success = downloader.GetInto(req->URL, req->get_TargetResponse());
-                retryOptions = RequestFinished(success, req.get());
-            } while (retryOptions.has_value());
+        while (auto scheduled = ScheduleNext()) {
+            auto& req = scheduled->request;
+            auto traceId = trace_id(*req);
+            Tracing::RecordInstant("dequeue", "dispatcher", traceId);
+
+            // requests can back out at the last moment, like a prefetch that was already requested by something else
+            if (req->BeginDispatch()) {
+                // prepare once, so retries don't redo the url escaping & header building
+                std::optional<PreparedRequest> localPrepared;
+                auto prepared = req->get_Prepared();
+                if (!prepared) prepared = &localPrepared.emplace(downloader.Prepare(req->URL));
+
+                // retry options used if response was ratelimited or something
+                std::optional<RetryOptions> retryOptions;
+                bool success = false;
+                do {
+                    if (retryOptions.has_value()) {
+                        _retryCount++;
+                        Tracing::ScopedSpan span("retry wait", "dispatcher", traceId);
+                        std::this_thread::sleep_for(retryOptions->waitTime);
+                    }
+
+                    success = downloader.GetInto(*prepared, req->get_TargetResponse(), nullptr, req->get_LiveTrafficClass());
+                    retryOptions = RequestFinished(success, req.get());
+                } while (retryOptions.has_value());
+
+                _requestCount++;
+                if (!success) _failedCount++;
+            }
 
-            std::unique_lock lock(_finishedMutex);
-            _finishedRequests.emplace_back(std::move(req));
-            lock.unlock();
+            // the rate limit of the slot was set when it was scheduled, so the next request for it waits if needed
+            ReleaseSlot(*scheduled);
 
-            // waits until the rate limit has passed, but if retries have happened this could just not sleep
-            std::this_thread::sleep_until(nextRatelimitedRequestTime);
+            if (retainFinishedRequests) {
+                std::unique_lock lock(_finishedMutex);
+                _finishedRequests.emplace_back(std::move(req));
+            } else {
+                RequestCompleted(std::move(req));
+            }
         }
     }
 }
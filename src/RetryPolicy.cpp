@@ -0,0 +1,48 @@
+#include "RetryPolicy.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace WebUtils {
+    bool RetryPolicy::ShouldRetry(int curlStatus, int httpCode) const noexcept {
+        // curl status 0 means a response arrived, so the http code decides
+        if (curlStatus != 0) return std::find(retryCurlCodes.begin(), retryCurlCodes.end(), curlStatus) != retryCurlCodes.end();
+        return std::find(retryHttpCodes.begin(), retryHttpCodes.end(), httpCode) != retryHttpCodes.end();
+    }
+
+    std::chrono::milliseconds RetryPolicy::Delay(std::size_t retry) const {
+        // computed as a double so large retry counts saturate at maxDelay instead of overflowing
+        auto backoff = std::min<double>(baseDelay.count() * std::pow(multiplier, retry), maxDelay.count());
+        if (!jitter || backoff <= 0) return std::chrono::milliseconds((int64_t)backoff);
+
+        static thread_local std::mt19937 gen(std::random_device{}());
+        std::uniform_real_distribution<double> dist(0, backoff);
+        return std::chrono::milliseconds((int64_t)dist(gen));
+    }
+
+    void LatencyTracker::Record(std::string_view origin, std::chrono::microseconds latency) {
+        std::lock_guard lock(_mutex);
+        auto& samples = _hosts[std::string(origin)];
+        samples.ring[samples.count % samples.ring.size()] = latency;
+        samples.count++;
+    }
+
+    std::optional<std::chrono::microseconds> LatencyTracker::Percentile(std::string_view origin, double percentile, std::size_t minSamples) const {
+        std::array<std::chrono::microseconds, WEBUTILS_LATENCY_SAMPLES> sorted;
+        std::size_t count;
+        {
+            std::lock_guard lock(_mutex);
+            auto itr = _hosts.find(std::string(origin));
+            if (itr == _hosts.end()) return std::nullopt;
+
+            count = std::min(itr->second.count, itr->second.ring.size());
+            if (count == 0 || count < minSamples) return std::nullopt;
+            std::copy_n(itr->second.ring.begin(), count, sorted.begin());
+        }
+
+        auto index = std::min<std::size_t>(count - 1, (std::size_t)(std::clamp(percentile, 0.0, 1.0) * count));
+        std::nth_element(sorted.begin(), sorted.begin() + index, sorted.begin() + count);
+        return sorted[index];
+    }
+}
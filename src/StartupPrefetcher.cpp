@@ -0,0 +1,209 @@
+#include "StartupPrefetcher.hpp"
+#include "RawResponse.hpp"
+#include "logging.hpp"
+
+#include <system_error>
+#include <vector>
+
+namespace WebUtils {
+    /// @brief first line of a manifest, manifests without it are ignored.
+    /// every line after it is "<useSSL 0|1> <escaped url> <encoding>\t<user agent>", the url can't contain spaces so the encoding runs up to the tab
+    static constexpr std::string_view MANIFEST_HEADER = "webutils-prefetch 3";
+
+    struct StartupPrefetcher::Prefetch {
+        enum class State {
+            /// @brief waiting in the dispatcher
+            Queued,
+            /// @brief being performed by the dispatcher
+            Running,
+            /// @brief finished, result is set
+            Done,
+            /// @brief requested before it started, the dispatcher skips it
+            Claimed,
+        };
+
+        Prefetch(bool useSSL, std::string encoding, std::string userAgent, TrafficClass trafficClass) : useSSL(useSSL), encoding(std::move(encoding)), userAgent(std::move(userAgent)), trafficClass(trafficClass) {}
+
+        /// @brief options the prefetch was made with, only requests with the same ones get its response
+        bool useSSL;
+        std::string encoding;
+        std::string userAgent;
+        /// @brief raised to foreground once a request waits on the prefetch
+        std::atomic<TrafficClass> trafficClass;
+
+        State state = State::Queued;
+        TransferResult result;
+        std::chrono::steady_clock::time_point doneAt;
+    };
+
+    struct StartupPrefetcher::PrefetchRequest : public IRequest {
+        PrefetchRequest(StartupPrefetcher& prefetcher, std::string url, std::shared_ptr<Prefetch> prefetch) : prefetcher(prefetcher), url(std::move(url), prefetch->useSSL, prefetch->encoding, prefetch->userAgent), prefetch(std::move(prefetch)) {
+            // manifests keep the escaped url
+            this->url.noEscape = true;
+        }
+
+        StartupPrefetcher& prefetcher;
+        URLOptions url;
+        std::shared_ptr<Prefetch> prefetch;
+        RawResponse response;
+
+        virtual URLOptions const& get_URL() const override { return url; }
+        virtual IResponse* get_TargetResponse() override { return &response; }
+        virtual IResponse const* get_TargetResponse() const override { return &response; }
+        virtual bool BeginDispatch() override { return prefetcher.BeginPrefetch(*prefetch); }
+        virtual std::atomic<TrafficClass> const* get_LiveTrafficClass() const override { return &prefetch->trafficClass; }
+    };
+
+    StartupPrefetcher::StartupPrefetcher() {
+        dispatcher.downloader.trafficClass = TrafficClass::Background;
+        dispatcher.retainFinishedRequests = false;
+        dispatcher.onRequestCompleted = [this](std::unique_ptr<IRequest> request) {
+            PrefetchCompleted(static_cast<PrefetchRequest&>(*request));
+        };
+    }
+
+    StartupPrefetcher::~StartupPrefetcher() {
+        {
+            std::lock_guard lock(_mutex);
+            _stopping = true;
+        }
+
+        if (_dispatch.valid()) _dispatch.wait();
+    }
+
+    StartupPrefetcher& StartupPrefetcher::Default() {
+        // leaked on purpose, destroying it at exit would wait on prefetches still in flight
+        static auto prefetcher = new StartupPrefetcher();
+        return *prefetcher;
+    }
+
+    void StartupPrefetcher::Start(std::filesystem::path manifestPath, std::chrono::seconds startupDuration) {
+        std::vector<std::unique_ptr<IRequest>> requests;
+        {
+            std::lock_guard lock(_mutex);
+            if (_started) return;
+
+            // the last manifest is read before it gets replaced by this startup's one
+            std::ifstream lastManifest(manifestPath);
+            std::string line;
+            if (std::getline(lastManifest, line) && line == MANIFEST_HEADER) {
+                while (std::getline(lastManifest, line) && requests.size() < WEBUTILS_PREFETCH_MAX_URLS) {
+                    if (line.size() < 3 || (line[0] != '0' && line[0] != '1') || line[1] != ' ') continue;
+                    auto urlEnd = line.find(' ', 2);
+                    auto encodingEnd = line.find('\t', urlEnd);
+                    if (urlEnd == std::string::npos || encodingEnd == std::string::npos) continue;
+                    auto url = line.substr(2, urlEnd - 2);
+                    auto encoding = line.substr(urlEnd + 1, encodingEnd - urlEnd - 1);
+                    auto userAgent = line.substr(encodingEnd + 1);
+                    if (url.empty()) continue;
+
+                    auto prefetch = std::make_shared<Prefetch>(line[0] == '1', std::move(encoding), std::move(userAgent), dispatcher.downloader.trafficClass);
+                    if (!_prefetches.emplace(url, prefetch).second) continue;
+                    requests.emplace_back(std::make_unique<PrefetchRequest>(*this, std::move(url), std::move(prefetch)));
+                }
+            }
+            lastManifest.close();
+
+            std::error_code error;
+            if (manifestPath.has_parent_path()) std::filesystem::create_directories(manifestPath.parent_path(), error);
+            _manifest.open(manifestPath, std::ios::out | std::ios::trunc);
+            if (_manifest.is_open()) {
+                _manifest << MANIFEST_HEADER << '\n';
+                _manifest.flush();
+            } else {
+                ERROR("Couldn't open prefetch manifest {}", manifestPath.string());
+            }
+
+            _recordUntil = std::chrono::steady_clock::now() + startupDuration;
+            _started = true;
+        }
+
+        VERBOSE("Prefetching {} startup urls", requests.size());
+        if (requests.empty()) return;
+        for (auto& request : requests) dispatcher.AddRequest(std::move(request));
+        _dispatch = dispatcher.StartDispatchIfNeeded();
+    }
+
+    void StartupPrefetcher::StopRecording() {
+        std::lock_guard lock(_mutex);
+        _manifest.close();
+    }
+
+    void StartupPrefetcher::Record(PreparedRequest const& prepared) {
+        if (!_manifest.is_open()) return;
+        if (std::chrono::steady_clock::now() >= _recordUntil) {
+            _manifest.close();
+            return;
+        }
+
+        auto& url = prepared.escapedURL();
+        auto& options = prepared.options();
+        // query strings tend to carry tokens, those don't belong on disk
+        if (url.find('?') != std::string::npos) return;
+        // a tab or newline in these would break the line apart
+        if (options.encoding.find_first_of("\t\n") != std::string::npos || prepared.userAgent().find_first_of("\t\n") != std::string::npos) return;
+        if (_recorded.size() >= WEBUTILS_PREFETCH_MAX_URLS || !_recorded.emplace(url).second) return;
+        // written right away, a startup that never finishes still leaves a manifest
+        _manifest << (options.useSSL ? '1' : '0') << ' ' << url << ' ' << options.encoding << '\t' << prepared.userAgent() << '\n';
+        _manifest.flush();
+    }
+
+    std::optional<TransferResult> StartupPrefetcher::Claim(PreparedRequest const& prepared) {
+        if (!_started) return std::nullopt;
+        if (!prepared.options().headers.empty()) return std::nullopt;
+
+        std::unique_lock lock(_mutex);
+        Record(prepared);
+
+        auto itr = _prefetches.find(prepared.escapedURL());
+        if (itr == _prefetches.end()) return std::nullopt;
+        // a request verifying peers must not get a response that wasn't verified, & one asking for an encoding or user agent must get it
+        auto& options = prepared.options();
+        auto& recorded = *itr->second;
+        if (recorded.useSSL != options.useSSL || recorded.encoding != options.encoding || recorded.userAgent != prepared.userAgent()) return std::nullopt;
+
+        // a prefetch is only handed out once, later requests for the url go out as usual
+        auto prefetch = std::move(itr->second);
+        _prefetches.erase(itr);
+
+        if (prefetch->state == Prefetch::State::Queued) {
+            prefetch->state = Prefetch::State::Claimed;
+            return std::nullopt;
+        }
+
+        // a foreground request waits on it now, so it shouldn't get throttled as background traffic anymore
+        auto trafficClass = prefetch->trafficClass.exchange(TrafficClass::Foreground);
+        auto timeOut = std::chrono::seconds(prepared.timeOut() > 0 ? prepared.timeOut() : WEBUTILS_TIMEOUT);
+        if (!_prefetchDone.wait_until(lock, std::chrono::steady_clock::now() + timeOut, [&]() { return prefetch->state == Prefetch::State::Done; })) {
+            // taking longer than the request itself may take, the caller is better off doing it itself
+            prefetch->trafficClass = trafficClass;
+            return std::nullopt;
+        }
+        if (std::chrono::steady_clock::now() - prefetch->doneAt > maxAge) return std::nullopt;
+
+        // failed prefetches are left to the caller, which might have a retry policy
+        auto& result = prefetch->result;
+        if (result.curlStatus != 0 || result.httpCode < 200 || result.httpCode >= 300) return std::nullopt;
+        return std::move(result);
+    }
+
+    bool StartupPrefetcher::BeginPrefetch(Prefetch& prefetch) {
+        std::lock_guard lock(_mutex);
+        if (_stopping || prefetch.state != Prefetch::State::Queued) return false;
+        prefetch.state = Prefetch::State::Running;
+        return true;
+    }
+
+    void StartupPrefetcher::PrefetchCompleted(PrefetchRequest& request) {
+        {
+            std::lock_guard lock(_mutex);
+            auto& prefetch = *request.prefetch;
+            if (prefetch.state != Prefetch::State::Running) return;
+
+            prefetch.result = std::move(request.response.result);
+            prefetch.doneAt = std::chrono::steady_clock::now();
+            prefetch.state = Prefetch::State::Done;
+        }
+        _prefetchDone.notify_all();
+    }
+}
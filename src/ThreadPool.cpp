@@ -0,0 +1,114 @@
+#include "ThreadPool.hpp"
+#include "logging.hpp"
+
+#include <algorithm>
+#include <exception>
+
+namespace WebUtils {
+    /// @brief pool & queue index of the worker running on this thread, if any
+    static thread_local ThreadPool const* currentPool = nullptr;
+    static thread_local std::size_t currentQueue = 0;
+
+    ThreadPool::ThreadPool(std::size_t threadCount) {
+        threadCount = std::max<std::size_t>(1, threadCount);
+        _queues.reserve(threadCount);
+        for (std::size_t i = 0; i < threadCount; i++) _queues.emplace_back(std::make_unique<Queue>());
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard lock(_sleepMutex);
+            _stopping = true;
+        }
+        _wake.notify_all();
+
+        for (auto& thread : _threads) thread.join();
+    }
+
+    ThreadPool& ThreadPool::Default() {
+        // leaked on purpose, joining at exit would wait on requests still in flight
+        static auto pool = new ThreadPool(WEBUTILS_THREAD_POOL_SIZE);
+        return *pool;
+    }
+
+    bool ThreadPool::IsWorkerThread() const noexcept {
+        return currentPool == this;
+    }
+
+    void ThreadPool::StartWorkers() {
+        _threads.reserve(_queues.size());
+        for (std::size_t i = 0; i < _queues.size(); i++) {
+            _threads.emplace_back(&ThreadPool::WorkerThread, this, i);
+        }
+    }
+
+    void ThreadPool::Push(std::function<void()> task) {
+        std::call_once(_started, &ThreadPool::StartWorkers, this);
+
+        {
+            // counted before the task is visible, a worker taking it right away would otherwise decrement first & wrap around.
+            // taken so a worker can't check _pending & go to sleep between the increment & the notify
+            std::lock_guard lock(_sleepMutex);
+            _pending++;
+        }
+
+        auto index = IsWorkerThread() ? currentQueue : _nextQueue++ % _queues.size();
+        {
+            std::lock_guard lock(_queues[index]->mutex);
+            _queues[index]->tasks.emplace_back(std::move(task));
+        }
+        _wake.notify_one();
+    }
+
+    bool ThreadPool::TryTake(std::size_t index, std::function<void()>& task) {
+        // own queue from the back, the most recent task is the most likely to still be in cache
+        {
+            auto& own = *_queues[index];
+            std::lock_guard lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+
+        // steal from the front of the others, the oldest tasks have waited the longest
+        for (std::size_t offset = 1; offset < _queues.size(); offset++) {
+            auto& other = *_queues[(index + offset) % _queues.size()];
+            std::lock_guard lock(other.mutex);
+            if (!other.tasks.empty()) {
+                task = std::move(other.tasks.front());
+                other.tasks.pop_front();
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void ThreadPool::WorkerThread(std::size_t index) {
+        currentPool = this;
+        currentQueue = index;
+
+        std::function<void()> task;
+        while (true) {
+            if (TryTake(index, task)) {
+                _pending--;
+                try {
+                    task();
+                } catch (std::exception const& e) {
+                    ERROR("Thread pool task threw: {}", e.what());
+                } catch (...) {
+                    ERROR("Thread pool task threw something that is not an exception");
+                }
+                task = nullptr;
+                continue;
+            }
+
+            std::unique_lock lock(_sleepMutex);
+            // queued tasks are still run when stopping, so nothing that was submitted gets lost
+            if (_stopping && _pending == 0) break;
+            _wake.wait(lock, [this]() { return _pending > 0 || _stopping; });
+        }
+    }
+}
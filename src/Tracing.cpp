@@ -0,0 +1,178 @@
+#include "Tracing.hpp"
+
+#include <fmt/core.h>
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace WebUtils::Tracing {
+    namespace detail {
+        std::atomic<bool> enabled = false;
+    }
+
+    struct Event {
+        char const* name;
+        char const* category;
+        /// @brief microseconds since the trace epoch
+        int64_t start;
+        /// @brief microseconds, negative for instant events
+        int64_t duration;
+        uint64_t id;
+        uint32_t threadId;
+    };
+
+    /// @brief an event in a ring buffer, guarded by a seqlock since readers copy it while the owner might be overwriting it
+    struct EventSlot {
+        /// @brief odd while being written, (index + 1) * 2 once the event with that index is in the slot
+        std::atomic<std::size_t> sequence = 0;
+        std::atomic<char const*> name = nullptr;
+        std::atomic<char const*> category = nullptr;
+        std::atomic<int64_t> start = 0;
+        std::atomic<int64_t> duration = 0;
+        std::atomic<uint64_t> id = 0;
+        std::atomic<uint32_t> threadId = 0;
+    };
+
+    /// @brief ring buffer written only by the thread that owns it, so recording never locks.
+    /// the owner publishes an event by bumping head after writing it, readers drop slots that got overwritten while copying
+    struct ThreadBuffer {
+        std::array<EventSlot, WEBUTILS_TRACE_BUFFER_SIZE> events;
+        std::atomic<std::size_t> head = 0;
+        /// @brief head at the time of the last clear, set by readers only
+        std::atomic<std::size_t> clearedAt = 0;
+    };
+
+    static clock::time_point const epoch = clock::now();
+
+    /// @brief guards the buffer lists, only taken when a thread first records or when dumping
+    static std::mutex buffersMutex;
+    /// @brief every buffer ever made, buffers are reused by new threads instead of freed so memory stays bounded by the max thread count
+    static std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    static std::vector<ThreadBuffer*> freeBuffers;
+
+    /// @brief returns the thread's buffer to the pool when the thread exits
+    struct ThreadBufferHandle {
+        ThreadBuffer* buffer = nullptr;
+        uint32_t threadId = 0;
+
+        ~ThreadBufferHandle() {
+            if (!buffer) return;
+            std::lock_guard lock(buffersMutex);
+            freeBuffers.emplace_back(buffer);
+        }
+    };
+
+    static thread_local ThreadBufferHandle threadBuffer;
+
+    static ThreadBufferHandle& GetThreadBuffer() {
+        if (threadBuffer.buffer) return threadBuffer;
+
+        static std::atomic<uint32_t> nextThreadId = 1;
+        threadBuffer.threadId = nextThreadId++;
+
+        std::lock_guard lock(buffersMutex);
+        if (!freeBuffers.empty()) {
+            threadBuffer.buffer = freeBuffers.back();
+            freeBuffers.pop_back();
+        } else {
+            threadBuffer.buffer = buffers.emplace_back(std::make_unique<ThreadBuffer>()).get();
+        }
+        return threadBuffer;
+    }
+
+    static int64_t ToMicros(clock::time_point time) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(time - epoch).count();
+    }
+
+    static void Push(char const* name, char const* category, int64_t start, int64_t duration, uint64_t id) {
+        auto& handle = GetThreadBuffer();
+        auto buffer = handle.buffer;
+
+        auto head = buffer->head.load(std::memory_order_relaxed);
+        auto& slot = buffer->events[head % buffer->events.size()];
+        slot.sequence.store(head * 2 + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.name.store(name, std::memory_order_relaxed);
+        slot.category.store(category, std::memory_order_relaxed);
+        slot.start.store(start, std::memory_order_relaxed);
+        slot.duration.store(duration, std::memory_order_relaxed);
+        slot.id.store(id, std::memory_order_relaxed);
+        slot.threadId.store(handle.threadId, std::memory_order_relaxed);
+        slot.sequence.store(head * 2 + 2, std::memory_order_release);
+        buffer->head.store(head + 1, std::memory_order_release);
+    }
+
+    void Enable(bool enabled) {
+        detail::enabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    void detail::RecordSpan(char const* name, char const* category, clock::time_point start, clock::time_point end, uint64_t id) {
+        Push(name, category, ToMicros(start), std::max<int64_t>(0, ToMicros(end) - ToMicros(start)), id);
+    }
+
+    void detail::RecordInstant(char const* name, char const* category, uint64_t id) {
+        Push(name, category, ToMicros(clock::now()), -1, id);
+    }
+
+    /// @brief copies out the events of a buffer that are still valid
+    static void CollectEvents(ThreadBuffer& buffer, std::vector<Event>& out) {
+        auto capacity = buffer.events.size();
+        auto head = buffer.head.load(std::memory_order_acquire);
+        auto begin = std::max(head > capacity ? head - capacity : 0, buffer.clearedAt.load(std::memory_order_relaxed));
+
+        for (auto i = begin; i < head; i++) {
+            auto& slot = buffer.events[i % capacity];
+            // the owner may have wrapped around while we were copying, a slot that doesn't hold event i (anymore) is skipped
+            if (slot.sequence.load(std::memory_order_acquire) != i * 2 + 2) continue;
+            Event event{
+                slot.name.load(std::memory_order_relaxed),
+                slot.category.load(std::memory_order_relaxed),
+                slot.start.load(std::memory_order_relaxed),
+                slot.duration.load(std::memory_order_relaxed),
+                slot.id.load(std::memory_order_relaxed),
+                slot.threadId.load(std::memory_order_relaxed)
+            };
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) != i * 2 + 2) continue;
+            out.emplace_back(event);
+        }
+    }
+
+    void WriteChromeTrace(std::ostream& out) {
+        std::vector<Event> events;
+        {
+            std::lock_guard lock(buffersMutex);
+            for (auto& buffer : buffers) CollectEvents(*buffer, events);
+        }
+
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        for (bool first = true; auto& event : events) {
+            if (!first) out << ',';
+            first = false;
+
+            if (event.duration < 0) {
+                out << fmt::format("{{\"name\":\"{}\",\"cat\":\"{}\",\"ph\":\"i\",\"s\":\"t\",\"ts\":{},\"pid\":1,\"tid\":{},\"args\":{{\"id\":{}}}}}", event.name, event.category, event.start, event.threadId, event.id);
+            } else {
+                out << fmt::format("{{\"name\":\"{}\",\"cat\":\"{}\",\"ph\":\"X\",\"ts\":{},\"dur\":{},\"pid\":1,\"tid\":{},\"args\":{{\"id\":{}}}}}", event.name, event.category, event.start, event.duration, event.threadId, event.id);
+            }
+        }
+        out << "]}";
+    }
+
+    bool WriteChromeTrace(std::filesystem::path const& path) {
+        std::ofstream file(path, std::ios::out | std::ios::trunc);
+        if (!file.is_open()) return false;
+        WriteChromeTrace(file);
+        return file.good();
+    }
+
+    void Clear() {
+        std::lock_guard lock(buffersMutex);
+        for (auto& buffer : buffers) {
+            buffer->clearedAt.store(buffer->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+        }
+    }
+}
@@ -0,0 +1,163 @@
+#include "UploadSource.hpp"
+
+#include <fmt/core.h>
+#include <random>
+
+namespace WebUtils {
+    std::optional<std::size_t> SpanUploadSource::Read(std::span<uint8_t> buffer) {
+        auto remaining = _data.subspan(_offset);
+        auto count = std::min(buffer.size(), remaining.size());
+        std::copy_n(remaining.begin(), count, buffer.begin());
+        _offset += count;
+        return count;
+    }
+
+    StreamUploadSource::StreamUploadSource(std::istream& stream, std::optional<std::size_t> size) : _stream(stream), _start(stream.tellg()), _size(size) {}
+
+    std::optional<std::size_t> StreamUploadSource::Read(std::span<uint8_t> buffer) {
+        if (_stream.bad()) return std::nullopt;
+        if (_stream.eof()) return 0;
+
+        _stream.read((char*)buffer.data(), buffer.size());
+        if (_stream.bad()) return std::nullopt;
+        return _stream.gcount();
+    }
+
+    bool StreamUploadSource::Rewind() {
+        if (_start == std::istream::pos_type(-1)) return false;
+        _stream.clear();
+        _stream.seekg(_start);
+        return !_stream.fail();
+    }
+
+    FileUploadSource::FileUploadSource(std::filesystem::path const& path) : _file(path, std::ios::binary | std::ios::in) {
+        std::error_code ec;
+        auto size = std::filesystem::file_size(path, ec);
+        if (!ec) _size = size;
+    }
+
+    std::optional<std::size_t> FileUploadSource::Read(std::span<uint8_t> buffer) {
+        if (!_file.is_open() || _file.bad()) return std::nullopt;
+        if (_file.eof()) return 0;
+
+        _file.read((char*)buffer.data(), buffer.size());
+        if (_file.bad()) return std::nullopt;
+        return _file.gcount();
+    }
+
+    std::optional<std::size_t> FileUploadSource::Size() const {
+        return _size;
+    }
+
+    bool FileUploadSource::Rewind() {
+        if (!_file.is_open()) return false;
+        _file.clear();
+        _file.seekg(0, std::ios::beg);
+        return !_file.fail();
+    }
+
+    static std::string randomBoundary() {
+        static char nibbleToChar[] = "0123456789abcdef";
+        std::random_device rd;
+        std::mt19937 gen(rd());
+        std::uniform_int_distribution<int> dist(0, 15);
+
+        std::string boundary = "WebUtilsBoundary";
+        for (int i = 0; i < 24; i++) boundary.push_back(nibbleToChar[dist(gen)]);
+        return boundary;
+    }
+
+    static std::string closingBoundary(std::string_view boundary) {
+        return fmt::format("--{}--\r\n", boundary);
+    }
+
+    MultipartUploadSource::MultipartUploadSource(std::string boundary) : _boundary(boundary.empty() ? randomBoundary() : std::move(boundary)) {}
+
+    bool MultipartUploadSource::AddField(std::string_view name, std::string_view value) {
+        // anything added after the closing boundary would end up outside of the form
+        if (_closed) return false;
+        _segments.emplace_back(fmt::format("--{}\r\nContent-Disposition: form-data; name=\"{}\"\r\n\r\n{}\r\n", _boundary, name, value));
+        return true;
+    }
+
+    bool MultipartUploadSource::AddPart(std::string_view name, std::unique_ptr<IUploadSource> source, std::optional<std::string_view> fileName, std::string_view contentType) {
+        if (!source || _closed) return false;
+
+        if (fileName.has_value()) {
+            _segments.emplace_back(fmt::format("--{}\r\nContent-Disposition: form-data; name=\"{}\"; filename=\"{}\"\r\nContent-Type: {}\r\n\r\n", _boundary, name, *fileName, contentType));
+        } else {
+            _segments.emplace_back(fmt::format("--{}\r\nContent-Disposition: form-data; name=\"{}\"\r\nContent-Type: {}\r\n\r\n", _boundary, name, contentType));
+        }
+        _segments.emplace_back(std::move(source));
+        _segments.emplace_back("\r\n");
+        return true;
+    }
+
+    bool MultipartUploadSource::AddFile(std::string_view name, std::filesystem::path const& path, std::string_view contentType) {
+        return AddPart(name, std::make_unique<FileUploadSource>(path), path.filename().string(), contentType);
+    }
+
+    void MultipartUploadSource::Close() {
+        if (_closed) return;
+        _segments.emplace_back(closingBoundary(_boundary));
+        _closed = true;
+    }
+
+    std::optional<std::size_t> MultipartUploadSource::Read(std::span<uint8_t> buffer) {
+        Close();
+
+        std::size_t written = 0;
+        while (written < buffer.size() && _segmentIndex < _segments.size()) {
+            auto target = buffer.subspan(written);
+            auto& segment = _segments[_segmentIndex];
+
+            if (auto str = std::get_if<std::string>(&segment)) {
+                auto count = std::min(target.size(), str->size() - _segmentOffset);
+                std::copy_n(str->begin() + _segmentOffset, count, target.begin());
+                _segmentOffset += count;
+                written += count;
+                if (_segmentOffset < str->size()) continue;
+            } else {
+                auto read = std::get<std::unique_ptr<IUploadSource>>(segment)->Read(target);
+                if (!read.has_value()) return std::nullopt;
+                written += *read;
+                // only a read of 0 means the source is done
+                if (*read > 0) continue;
+            }
+
+            _segmentIndex++;
+            _segmentOffset = 0;
+        }
+
+        return written;
+    }
+
+    std::optional<std::size_t> MultipartUploadSource::Size() const {
+        std::size_t size = _closed ? 0 : closingBoundary(_boundary).size();
+        for (auto& segment : _segments) {
+            if (auto str = std::get_if<std::string>(&segment)) {
+                size += str->size();
+            } else {
+                auto partSize = std::get<std::unique_ptr<IUploadSource>>(segment)->Size();
+                if (!partSize.has_value()) return std::nullopt;
+                size += *partSize;
+            }
+        }
+        return size;
+    }
+
+    std::optional<std::string> MultipartUploadSource::ContentType() const {
+        return fmt::format("multipart/form-data; boundary={}", _boundary);
+    }
+
+    bool MultipartUploadSource::Rewind() {
+        for (auto& segment : _segments) {
+            if (auto source = std::get_if<std::unique_ptr<IUploadSource>>(&segment)) {
+                if (!(*source)->Rewind()) return false;
+            }
+        }
+        _segmentIndex = 0;
+        _segmentOffset = 0;
+        return true;
+    }
+}
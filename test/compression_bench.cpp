@@ -0,0 +1,69 @@
+// compares the cpu cost of compressing request bodies with the bytes it saves.
+// bodies are posted to a loopback transport, so the measured time is the compression & nothing of the network
+#include "DownloaderUtility.hpp"
+#include "LoopbackTransport.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace WebUtils;
+
+static std::vector<uint8_t> json_sample(std::size_t size) {
+    std::string json = "[";
+    std::mt19937 gen(1);
+    for (int i = 0; json.size() < size; i++) {
+        char entry[160];
+        std::snprintf(entry, sizeof(entry), "%s{\"rank\":%d,\"player\":\"player%u\",\"score\":%u,\"accuracy\":%.4f,\"modifiers\":[\"NF\",\"FS\"]}", i ? "," : "", i, (unsigned)(gen() % 100000), (unsigned)(gen() % 1000000), (gen() % 10000) / 10000.0);
+        json += entry;
+    }
+    json += "]";
+    return std::vector<uint8_t>(json.begin(), json.end());
+}
+
+static std::vector<uint8_t> binary_sample(std::size_t size) {
+    // random bytes stand in for already compressed data like images & audio
+    std::vector<uint8_t> data(size);
+    std::mt19937 gen(2);
+    for (auto& byte : data) byte = gen();
+    return data;
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 20;
+
+    std::size_t sentSize = 0;
+    auto loopback = std::make_shared<LoopbackTransport>();
+    loopback->Serve("https://bench.local/", [&](LoopbackRequest const& request) {
+        sentSize = request.body.size();
+        return LoopbackResponse{};
+    });
+    DownloaderUtility downloader{.userAgent = "bench", .timeOut = 0, .transport = loopback};
+
+    struct Sample { char const* name; std::vector<uint8_t> data; };
+    Sample samples[] = {
+        { "json 1MiB", json_sample(1 << 20) },
+        { "json 16KiB", json_sample(16 << 10) },
+        { "binary 1MiB", binary_sample(1 << 20) },
+    };
+    struct Mode { char const* name; BodyCompression compression; };
+    Mode modes[] = { { "none", BodyCompression::None }, { "gzip", BodyCompression::Gzip }, { "deflate", BodyCompression::Deflate } };
+
+    std::printf("level %d, %d iterations\n", WEBUTILS_COMPRESSION_LEVEL, iterations);
+    std::printf("%-12s %-8s %10s %10s %7s %10s %10s\n", "sample", "mode", "raw", "sent", "ratio", "ms/post", "MiB/s");
+    for (auto& sample : samples) {
+        for (auto& mode : modes) {
+            URLOptions options("https://bench.local/post");
+            options.bodyCompression = mode.compression;
+
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < iterations; i++) downloader.Post<DataResponse>(options, sample.data);
+            auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+            std::printf("%-12s %-8s %10zu %10zu %6.1f%% %10.3f %10.1f\n", sample.name, mode.name, sample.data.size(), sentSize,
+                100.0 * sentSize / sample.data.size(), seconds * 1000, sample.data.size() / seconds / (1 << 20));
+        }
+    }
+}
@@ -0,0 +1,88 @@
+// drives the retry & hedge policies of a downloader through a loopback transport.
+// exits with 1 if any check failed
+#include "DownloaderUtility.hpp"
+#include "LoopbackTransport.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+
+using namespace WebUtils;
+
+static int failures = 0;
+
+static void check(bool ok, char const* what) {
+    std::printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok) failures++;
+}
+
+/// @brief handler failing with an http code for the first few requests, then succeeding
+static LoopbackTransport::Handler fail_times(int times, int httpCode, std::atomic<int>& hits, URLOptions::HeaderMap headers = {}) {
+    return [times, httpCode, &hits, headers](LoopbackRequest const&) {
+        if (hits++ < times) return LoopbackResponse{ .httpCode = httpCode, .headers = headers };
+        return LoopbackResponse::Text("ok");
+    };
+}
+
+static void retries() {
+    auto loopback = std::make_shared<LoopbackTransport>();
+    DownloaderUtility downloader{.userAgent = "test", .timeOut = 5, .transport = loopback};
+    downloader.retryPolicy = { .maxRetries = 3, .baseDelay = std::chrono::milliseconds(1), .jitter = false };
+
+    std::atomic<int> recovering = 0, failing = 0, notFound = 0, limited = 0;
+    loopback->Serve("https://retry.test/recovering", fail_times(2, 503, recovering));
+    loopback->Serve("https://retry.test/failing", fail_times(100, 503, failing));
+    loopback->Serve("https://retry.test/missing", fail_times(100, 404, notFound));
+    loopback->Serve("https://retry.test/limited", fail_times(1, 429, limited, {{"Retry-After", "1"}}));
+
+    auto response = downloader.Get<StringResponse>(URLOptions("https://retry.test/recovering"));
+    check(response.HttpCode == 200 && recovering == 3, "retryable errors are retried until the request succeeds");
+
+    response = downloader.Get<StringResponse>(URLOptions("https://retry.test/failing"));
+    check(response.HttpCode == 503 && failing == 4, "retries stop after maxRetries, with the last response kept");
+
+    response = downloader.Get<StringResponse>(URLOptions("https://retry.test/missing"));
+    check(response.HttpCode == 404 && notFound == 1, "errors that aren't retryable aren't retried");
+
+    // Retry-After asks for a second, maxDelay caps that
+    downloader.retryPolicy.maxDelay = std::chrono::milliseconds(100);
+    auto start = std::chrono::steady_clock::now();
+    response = downloader.Get<StringResponse>(URLOptions("https://retry.test/limited"));
+    auto waited = std::chrono::steady_clock::now() - start;
+    check(response.HttpCode == 200 && waited >= std::chrono::milliseconds(100) && waited < std::chrono::milliseconds(900), "Retry-After is waited out up to maxDelay");
+}
+
+static void hedging() {
+    auto loopback = std::make_shared<LoopbackTransport>(LoopbackConditions{ .latency = std::chrono::milliseconds(10) });
+    loopback->Serve("https://hedge.test/", LoopbackResponse::Text("ok"));
+    DownloaderUtility downloader{.userAgent = "test", .timeOut = 5, .transport = loopback};
+
+    // percentile hedging waits for enough samples of the host
+    downloader.hedgePolicy = HedgePolicy{ .percentile = 0.5, .minSamples = 5, .minDelay = std::chrono::milliseconds(1) };
+    for (int i = 0; i < 5; i++) downloader.Get<StringResponse>(URLOptions("https://hedge.test/"));
+    check(loopback->RequestCount() == 5, "requests aren't hedged before the host has minSamples");
+    check(downloader.latencyTracker->Percentile("https://hedge.test", 0.5, 5).has_value(), "successful requests record their latency");
+
+    // with random latencies the hedge wins some of the requests, what gets recorded has to be what the caller waited
+    loopback->SetConditions({ .jitter = std::chrono::milliseconds(200) });
+    downloader.hedgePolicy = HedgePolicy{ .delay = std::chrono::milliseconds(60) };
+    bool recordedWaited = true;
+    for (int i = 0; i < 30; i++) {
+        downloader.latencyTracker = std::make_shared<LatencyTracker>();
+        auto start = std::chrono::steady_clock::now();
+        downloader.Get<StringResponse>(URLOptions("https://hedge.test/"));
+        auto waited = std::chrono::steady_clock::now() - start;
+
+        auto recorded = downloader.latencyTracker->Percentile("https://hedge.test", 1, 1);
+        if (!recorded.has_value() || *recorded > waited || *recorded < waited - std::chrono::milliseconds(25)) recordedWaited = false;
+    }
+    check(loopback->RequestCount() > 5 + 30, "slow requests get hedged");
+    check(recordedWaited, "the recorded latency is the one the caller saw, hedge delay included");
+}
+
+int main() {
+    retries();
+    hedging();
+    return failures == 0 ? 0 : 1;
+}